@@ -0,0 +1,243 @@
+/* arena.c - Per-process bump allocation with bulk release
+ *
+ * Released standard chunks are spliced onto the cache whole. When that
+ * leaves more than ARENA_CACHE_MAX cached, a softirq returns the excess
+ * to the heap at the next scheduling point, so process_exit() itself
+ * never walks the list. The heap's reclaim hook empties the cache when
+ * an allocation would fail.
+ */
+#include "arena.h"
+#include "memory.h"
+#include "spinlock.h"
+#include "defer.h"
+
+/* Data starts 16-byte aligned, as heap_alloc's do */
+#define CHUNK_HEADER ((sizeof(arena_chunk_t) + 15) & ~(size_t)15)
+
+static arena_chunk_t *cache;
+static arena_stats_t stats;
+static spinlock_t cache_lock;
+static work_t trim_work;
+
+/* Give cached chunks past keep back to the heap; returns how many */
+static uint32_t trim_to(uint32_t keep)
+{
+    arena_chunk_t *excess = 0;
+    uint32_t trimmed = 0;
+    uint32_t flags = spin_lock_irqsave(&cache_lock);
+    while (stats.chunks_cached > keep)
+    {
+        arena_chunk_t *chunk = cache;
+        cache = chunk->next;
+        chunk->next = excess;
+        excess = chunk;
+        stats.chunks_cached--;
+        stats.trimmed++;
+        trimmed++;
+    }
+    spin_unlock_irqrestore(&cache_lock, flags);
+
+    /* The heap has its own lock; never nest it inside ours */
+    while (excess)
+    {
+        arena_chunk_t *next = excess->next;
+        heap_free(excess);
+        excess = next;
+    }
+    return trimmed;
+}
+
+static void trim_cache(work_t *work, uint32_t count)
+{
+    (void)work;
+    (void)count;
+    trim_to(ARENA_CACHE_MAX);
+}
+
+/* heap_alloc is out of space: an idle chunk is worth less than that */
+static uint32_t drain_cache(void)
+{
+    return trim_to(0);
+}
+
+void arena_cache_init(void)
+{
+    cache = 0;
+    stats.chunks_cached = 0;
+    stats.heap_chunks = 0;
+    stats.reuses = 0;
+    stats.releases = 0;
+    stats.trimmed = 0;
+    spin_lock_init(&cache_lock, "arena cache");
+    work_init(&trim_work, trim_cache, 0);
+    heap_set_reclaim(drain_cache);
+}
+
+void arena_init(arena_t *arena, uint32_t quota)
+{
+    arena->chunks = 0;
+    arena->tail = 0;
+    arena->large = 0;
+    arena->bump = 0;
+    arena->end = 0;
+    arena->last = 0;
+    arena->nchunks = 0;
+    arena->reserved = 0;
+    arena->used = 0;
+    arena->quota = quota;
+    arena->allocs = 0;
+    arena->failures = 0;
+}
+
+/* The quota may have been lowered below what the arena already holds */
+static int over_quota(const arena_t *arena, uint32_t bytes)
+{
+    return arena->quota &&
+           (arena->reserved >= arena->quota || bytes > arena->quota - arena->reserved);
+}
+
+static arena_chunk_t *take_chunk(void)
+{
+    uint32_t flags = spin_lock_irqsave(&cache_lock);
+    arena_chunk_t *chunk = cache;
+    if (chunk)
+    {
+        cache = chunk->next;
+        stats.chunks_cached--;
+        stats.reuses++;
+    }
+    else
+    {
+        stats.heap_chunks++;
+    }
+    spin_unlock_irqrestore(&cache_lock, flags);
+
+    if (!chunk)
+    {
+        chunk = (arena_chunk_t *)heap_alloc(ARENA_CHUNK_SIZE);
+    }
+    return chunk;
+}
+
+/* A heap block of its own for a request that would waste most of a chunk */
+static void *alloc_large(arena_t *arena, size_t need)
+{
+    if (need > 0xFFFFFFFFu - CHUNK_HEADER)
+    {
+        return 0;
+    }
+    uint32_t bytes = (uint32_t)(CHUNK_HEADER + need);
+    arena_chunk_t *chunk = over_quota(arena, bytes) ? 0 : (arena_chunk_t *)heap_alloc(bytes);
+    if (!chunk)
+    {
+        return 0;
+    }
+    chunk->size = bytes;
+    chunk->next = arena->large;
+    arena->large = chunk;
+    arena->reserved += bytes;
+    arena->used += (uint32_t)need;
+    arena->allocs++;
+    return (uint8_t *)chunk + CHUNK_HEADER;
+}
+
+void *arena_alloc_slow(arena_t *arena, size_t size)
+{
+    size_t need = (size + 15) & ~(size_t)15;
+    if (!size || need < size)
+    {
+        return 0;
+    }
+
+    void *ptr;
+    if (need >= ARENA_LARGE)
+    {
+        ptr = alloc_large(arena, need);
+    }
+    else
+    {
+        /* The rest of the current chunk is abandoned until release */
+        arena_chunk_t *chunk = over_quota(arena, ARENA_CHUNK_SIZE) ? 0 : take_chunk();
+        if (chunk)
+        {
+            chunk->size = ARENA_CHUNK_SIZE;
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+            if (!arena->tail)
+            {
+                arena->tail = chunk;
+            }
+            arena->nchunks++;
+            arena->reserved += ARENA_CHUNK_SIZE;
+            arena->bump = (uint8_t *)chunk + CHUNK_HEADER;
+            arena->end = (uint8_t *)chunk + ARENA_CHUNK_SIZE;
+        }
+        ptr = chunk ? arena_alloc(arena, size) : 0;
+    }
+    if (!ptr)
+    {
+        arena->failures++;
+    }
+    return ptr;
+}
+
+void arena_free(arena_t *arena, void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (ptr == arena->last)
+    {
+        arena->used -= (uint32_t)(arena->bump - (uint8_t *)ptr);
+        arena->bump = (uint8_t *)ptr;
+        arena->last = 0;
+        return;
+    }
+
+    /* Large blocks go straight back to the heap */
+    for (arena_chunk_t **link = &arena->large; *link; link = &(*link)->next)
+    {
+        arena_chunk_t *chunk = *link;
+        if ((uint8_t *)chunk + CHUNK_HEADER == ptr)
+        {
+            *link = chunk->next;
+            arena->reserved -= chunk->size;
+            arena->used -= (uint32_t)(chunk->size - CHUNK_HEADER);
+            heap_free(chunk);
+            return;
+        }
+    }
+}
+
+void arena_release(arena_t *arena)
+{
+    if (arena->chunks)
+    {
+        uint32_t flags = spin_lock_irqsave(&cache_lock);
+        arena->tail->next = cache;
+        cache = arena->chunks;
+        stats.chunks_cached += arena->nchunks;
+        stats.releases++;
+        int trim = stats.chunks_cached > ARENA_CACHE_MAX;
+        spin_unlock_irqrestore(&cache_lock, flags);
+        if (trim)
+        {
+            work_queue(&trim_work);
+        }
+    }
+
+    arena_chunk_t *chunk = arena->large;
+    while (chunk)
+    {
+        arena_chunk_t *next = chunk->next;
+        heap_free(chunk);
+        chunk = next;
+    }
+    arena_init(arena, arena->quota);
+}
+
+void arena_get_stats(arena_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,84 @@
+/* arena.h - Per-process bump allocation with bulk release
+ *
+ * Each process owns an arena (process_t.arena). Allocations bump a
+ * pointer through fixed-size chunks carved from the heap, and nothing is
+ * freed one at a time: arena_release() hands every chunk back at once,
+ * which process_exit() does. Chunks go to a shared cache rather than the
+ * heap's free list, so a spawn/exit storm reuses the same chunks instead
+ * of scattering small blocks through the heap. Requests too big to share
+ * a chunk get a heap block of their own. A heap allocation that would
+ * otherwise fail first takes every cached chunk back.
+ *
+ * A quota caps the chunk bytes an arena may hold; 0 means no limit.
+ * Only the owning process may allocate from its arena.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "types.h"
+#include "memory.h"
+
+#define ARENA_CHUNK_SIZE 4096              /* header included */
+#define ARENA_LARGE (ARENA_CHUNK_SIZE / 4) /* and up: a block of its own */
+/* Cached chunks kept past a trim: a quarter of the heap at most */
+#define ARENA_CACHE_MAX (HEAP_SIZE / ARENA_CHUNK_SIZE / 4)
+
+typedef struct arena_chunk
+{
+    struct arena_chunk *next;
+    uint32_t size; /* bytes including the header */
+} arena_chunk_t;
+
+typedef struct arena
+{
+    arena_chunk_t *chunks; /* standard chunks, newest first */
+    arena_chunk_t *tail;   /* oldest, so the list splices onto the cache in O(1) */
+    arena_chunk_t *large;  /* oversized requests, one block each */
+    uint8_t *bump;
+    uint8_t *end;
+    void *last;        /* newest allocation; arena_free can take it back */
+    uint32_t nchunks;  /* standard chunks held */
+    uint32_t reserved; /* chunk bytes held, what the quota limits */
+    uint32_t used;     /* bytes handed out */
+    uint32_t quota;
+    uint32_t allocs;
+    uint32_t failures; /* out of heap or over quota */
+} arena_t;
+
+typedef struct arena_stats
+{
+    uint32_t chunks_cached;
+    uint32_t heap_chunks; /* standard chunks taken from the heap */
+    uint32_t reuses;      /* standard chunks taken from the cache */
+    uint32_t releases;
+    uint32_t trimmed; /* cached chunks given back to the heap */
+} arena_stats_t;
+
+/* Empty the chunk cache; at boot, and on the host after memory_init */
+void arena_cache_init(void);
+void arena_init(arena_t *arena, uint32_t quota);
+void *arena_alloc_slow(arena_t *arena, size_t size);
+/* Take back ptr now if it is the newest allocation or a large block;
+ * anything else waits for arena_release */
+void arena_free(arena_t *arena, void *ptr);
+/* Drop every allocation and hand the chunks back; the quota is kept */
+void arena_release(arena_t *arena);
+void arena_get_stats(arena_stats_t *out);
+
+/* 16-byte aligned, 0 when out of memory or over quota */
+static inline void *arena_alloc(arena_t *arena, size_t size)
+{
+    size_t need = (size + 15) & ~(size_t)15;
+    if (need && need <= (size_t)(arena->end - arena->bump))
+    {
+        void *ptr = arena->bump;
+        arena->bump += need;
+        arena->used += need;
+        arena->allocs++;
+        arena->last = ptr;
+        return ptr;
+    }
+    return arena_alloc_slow(arena, size);
+}
+
+#endif
@@ -0,0 +1,318 @@
+/* ata.c - ATA (IDE) disk driver with bus-master DMA and PIO fallback */
+#include "ata.h"
+#include "io.h"
+#include "pci.h"
+
+/* Primary channel task-file registers */
+#define ATA_DATA 0x1F0
+#define ATA_ERROR 0x1F1
+#define ATA_SECCOUNT 0x1F2
+#define ATA_LBA_LO 0x1F3
+#define ATA_LBA_MID 0x1F4
+#define ATA_LBA_HI 0x1F5
+#define ATA_DRIVE 0x1F6
+#define ATA_STATUS 0x1F7
+#define ATA_COMMAND 0x1F7
+#define ATA_ALT_STATUS 0x3F6
+
+#define ATA_SR_ERR 0x01
+#define ATA_SR_DRQ 0x08
+#define ATA_SR_DF 0x20
+#define ATA_SR_BSY 0x80
+
+#define ATA_CMD_READ_PIO 0x20
+#define ATA_CMD_WRITE_PIO 0x30
+#define ATA_CMD_READ_DMA 0xC8
+#define ATA_CMD_WRITE_DMA 0xCA
+#define ATA_CMD_FLUSH 0xE7
+#define ATA_CMD_IDENTIFY 0xEC
+
+/* Bus-master IDE registers (offsets from BAR4, primary channel) */
+#define BM_COMMAND 0x00
+#define BM_STATUS 0x02
+#define BM_PRDT 0x04
+
+#define BM_CMD_START 0x01
+#define BM_CMD_READ 0x08 /* device -> memory */
+#define BM_SR_ACTIVE 0x01
+#define BM_SR_ERR 0x02
+#define BM_SR_IRQ 0x04
+
+/* Sectors per command; keeps the PRD table small even when every
+   sector buffer straddles a 64 KB boundary and needs two entries */
+#define ATA_MAX_SECTORS 16
+#define ATA_MAX_PRD (ATA_MAX_SECTORS * 2)
+
+typedef struct prd
+{
+    uint32_t addr;
+    uint16_t bytes;
+    uint16_t flags; /* bit 15: end of table */
+} prd_t;
+
+static prd_t prd_table[ATA_MAX_PRD] __attribute__((aligned(256)));
+static uint16_t bm_base = 0;
+static int drive_present = 0;
+static uint32_t total_sectors = 0;
+
+static void io_delay(void)
+{
+    /* Each alternate status read takes ~100ns; four give the 400ns settle time */
+    for (int i = 0; i < 4; i++)
+    {
+        inb(ATA_ALT_STATUS);
+    }
+}
+
+static int wait_not_busy(void)
+{
+    uint8_t status;
+    do
+    {
+        status = inb(ATA_STATUS);
+    } while (status & ATA_SR_BSY);
+    return (status & (ATA_SR_ERR | ATA_SR_DF)) ? -1 : 0;
+}
+
+static int wait_drq(void)
+{
+    uint8_t status;
+    do
+    {
+        status = inb(ATA_STATUS);
+        if (status & (ATA_SR_ERR | ATA_SR_DF))
+        {
+            return -1;
+        }
+    } while ((status & ATA_SR_BSY) || !(status & ATA_SR_DRQ));
+    return 0;
+}
+
+static void issue_command(uint32_t lba, uint32_t count, uint8_t cmd)
+{
+    outb(ATA_DRIVE, 0xE0 | ((lba >> 24) & 0x0F)); /* master, LBA mode */
+    io_delay();
+    outb(ATA_SECCOUNT, (uint8_t)count); /* 0 would mean 256 */
+    outb(ATA_LBA_LO, (uint8_t)lba);
+    outb(ATA_LBA_MID, (uint8_t)(lba >> 8));
+    outb(ATA_LBA_HI, (uint8_t)(lba >> 16));
+    outb(ATA_COMMAND, cmd);
+}
+
+static int pio_transfer(int write, uint32_t lba, uint32_t count, uint8_t *const bufs[])
+{
+    if (wait_not_busy() < 0)
+    {
+        return -1;
+    }
+    issue_command(lba, count, write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        io_delay();
+        if (wait_drq() < 0)
+        {
+            return -1;
+        }
+        if (write)
+        {
+            outsw(ATA_DATA, bufs[i], ATA_SECTOR_SIZE / 2);
+        }
+        else
+        {
+            insw(ATA_DATA, bufs[i], ATA_SECTOR_SIZE / 2);
+        }
+    }
+
+    if (write)
+    {
+        outb(ATA_COMMAND, ATA_CMD_FLUSH);
+    }
+    return wait_not_busy();
+}
+
+/* Fill the PRD table, splitting any buffer that crosses a 64 KB boundary */
+static int build_prd_table(uint32_t count, uint8_t *const bufs[])
+{
+    int n = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t addr = (uint32_t)bufs[i];
+        uint32_t left = ATA_SECTOR_SIZE;
+        while (left)
+        {
+            uint32_t to_boundary = 0x10000 - (addr & 0xFFFF);
+            uint32_t chunk = left < to_boundary ? left : to_boundary;
+            if (n == ATA_MAX_PRD)
+            {
+                return -1;
+            }
+            prd_table[n].addr = addr;
+            prd_table[n].bytes = (uint16_t)chunk;
+            prd_table[n].flags = 0;
+            n++;
+            addr += chunk;
+            left -= chunk;
+        }
+    }
+    prd_table[n - 1].flags = 0x8000;
+    return 0;
+}
+
+static int dma_transfer(int write, uint32_t lba, uint32_t count, uint8_t *const bufs[])
+{
+    if (build_prd_table(count, bufs) < 0 || wait_not_busy() < 0)
+    {
+        return -1;
+    }
+
+    uint8_t dir = write ? 0 : BM_CMD_READ;
+    outb(bm_base + BM_COMMAND, 0);
+    outl(bm_base + BM_PRDT, (uint32_t)prd_table);
+    outb(bm_base + BM_STATUS, inb(bm_base + BM_STATUS) | BM_SR_IRQ | BM_SR_ERR);
+    outb(bm_base + BM_COMMAND, dir);
+
+    issue_command(lba, count, write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA);
+    outb(bm_base + BM_COMMAND, dir | BM_CMD_START);
+
+    /* Interrupts are not routed yet, so poll the bus-master status */
+    uint8_t bm_status;
+    do
+    {
+        bm_status = inb(bm_base + BM_STATUS);
+    } while ((bm_status & BM_SR_ACTIVE) && !(bm_status & (BM_SR_IRQ | BM_SR_ERR)));
+
+    outb(bm_base + BM_COMMAND, dir);
+    outb(bm_base + BM_STATUS, bm_status | BM_SR_IRQ | BM_SR_ERR);
+
+    if (wait_not_busy() < 0 || (bm_status & BM_SR_ERR))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int ata_transfer(int write, uint32_t lba, uint32_t count, uint8_t *const bufs[])
+{
+    if (!drive_present || !bufs || lba + count > total_sectors || lba + count < lba)
+    {
+        return -1;
+    }
+
+    while (count)
+    {
+        uint32_t n = count < ATA_MAX_SECTORS ? count : ATA_MAX_SECTORS;
+        int rc = bm_base ? dma_transfer(write, lba, n, bufs)
+                         : pio_transfer(write, lba, n, bufs);
+        if (rc < 0)
+        {
+            return -1;
+        }
+        lba += n;
+        count -= n;
+        bufs += n;
+    }
+    return 0;
+}
+
+int ata_readv(uint32_t lba, uint32_t count, uint8_t *const bufs[])
+{
+    return ata_transfer(0, lba, count, bufs);
+}
+
+int ata_writev(uint32_t lba, uint32_t count, uint8_t *const bufs[])
+{
+    return ata_transfer(1, lba, count, bufs);
+}
+
+static void setup_bus_master(void)
+{
+    pci_device_t dev;
+    if (!pci_find_class(0x01, 0x01, &dev)) /* mass storage, IDE */
+    {
+        return;
+    }
+
+    uint32_t class_reg = pci_config_read(dev.bus, dev.slot, dev.func, 0x08);
+    if (!(class_reg & 0x8000)) /* prog-if bit 7: bus mastering supported */
+    {
+        return;
+    }
+
+    uint32_t bar4 = pci_config_read(dev.bus, dev.slot, dev.func, 0x20);
+    if (!(bar4 & 0x1)) /* expect an I/O space BAR */
+    {
+        return;
+    }
+
+    uint32_t cmd = pci_config_read(dev.bus, dev.slot, dev.func, 0x04);
+    pci_config_write(dev.bus, dev.slot, dev.func, 0x04, cmd | 0x5); /* I/O + bus master */
+    bm_base = (uint16_t)(bar4 & 0xFFFC);
+}
+
+int ata_init(void)
+{
+    uint16_t ident[256];
+
+    drive_present = 0;
+    total_sectors = 0;
+    bm_base = 0;
+
+    if (inb(ATA_STATUS) == 0xFF) /* floating bus: no controller */
+    {
+        return 0;
+    }
+
+    outb(ATA_DRIVE, 0xA0);
+    io_delay();
+    outb(ATA_SECCOUNT, 0);
+    outb(ATA_LBA_LO, 0);
+    outb(ATA_LBA_MID, 0);
+    outb(ATA_LBA_HI, 0);
+    outb(ATA_COMMAND, ATA_CMD_IDENTIFY);
+
+    if (inb(ATA_STATUS) == 0)
+    {
+        return 0;
+    }
+    while (inb(ATA_STATUS) & ATA_SR_BSY)
+        ;
+    if (inb(ATA_LBA_MID) || inb(ATA_LBA_HI)) /* ATAPI or SATA signature */
+    {
+        return 0;
+    }
+    if (wait_drq() < 0)
+    {
+        return 0;
+    }
+    insw(ATA_DATA, ident, 256);
+
+    total_sectors = (uint32_t)ident[60] | ((uint32_t)ident[61] << 16);
+    if (!total_sectors)
+    {
+        return 0;
+    }
+    drive_present = 1;
+
+    /* Word 49 bit 8: DMA supported */
+    if (ident[49] & 0x0100)
+    {
+        setup_bus_master();
+    }
+    return 1;
+}
+
+int ata_present(void)
+{
+    return drive_present;
+}
+
+int ata_dma_enabled(void)
+{
+    return bm_base != 0;
+}
+
+uint32_t ata_sector_count(void)
+{
+    return total_sectors;
+}
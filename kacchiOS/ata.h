@@ -0,0 +1,18 @@
+/* ata.h - ATA (IDE) disk driver, primary master */
+#ifndef ATA_H
+#define ATA_H
+
+#include "types.h"
+
+#define ATA_SECTOR_SIZE 512
+
+int ata_init(void);
+int ata_present(void);
+int ata_dma_enabled(void);
+uint32_t ata_sector_count(void);
+
+/* Vectored transfers: bufs[i] holds sector lba + i (ATA_SECTOR_SIZE bytes) */
+int ata_readv(uint32_t lba, uint32_t count, uint8_t *const bufs[]);
+int ata_writev(uint32_t lba, uint32_t count, uint8_t *const bufs[]);
+
+#endif
@@ -0,0 +1,461 @@
+/* bcache.c - Block buffer cache on top of the ATA driver */
+#include "bcache.h"
+#include "memory.h"
+#include "string.h"
+
+#define BCACHE_HASH_SIZE 64
+#define BCACHE_MAX_RUN 16 /* blocks per batched disk command */
+
+static bcache_buf_t *bufs = 0;
+static uint8_t *data_pool = 0;
+static uint32_t nbufs = 0;
+static bcache_buf_t *hash_table[BCACHE_HASH_SIZE];
+static bcache_buf_t *lru_head = 0;
+static bcache_buf_t *lru_tail = 0;
+
+static uint32_t ra_window = BCACHE_DEFAULT_READAHEAD;
+static uint32_t last_block = 0xFFFFFFFF;
+static bcache_stats_t stats;
+
+/* ---- LRU and hash bookkeeping ---- */
+
+static void lru_unlink(bcache_buf_t *b)
+{
+    if (b->lru_prev)
+        b->lru_prev->lru_next = b->lru_next;
+    else
+        lru_head = b->lru_next;
+    if (b->lru_next)
+        b->lru_next->lru_prev = b->lru_prev;
+    else
+        lru_tail = b->lru_prev;
+    b->lru_prev = b->lru_next = 0;
+}
+
+static void lru_push_front(bcache_buf_t *b)
+{
+    b->lru_prev = 0;
+    b->lru_next = lru_head;
+    if (lru_head)
+        lru_head->lru_prev = b;
+    lru_head = b;
+    if (!lru_tail)
+        lru_tail = b;
+}
+
+static void lru_touch(bcache_buf_t *b)
+{
+    if (lru_head != b)
+    {
+        lru_unlink(b);
+        lru_push_front(b);
+    }
+}
+
+static bcache_buf_t *lookup(uint32_t blockno)
+{
+    bcache_buf_t *b = hash_table[blockno % BCACHE_HASH_SIZE];
+    while (b && b->blockno != blockno)
+    {
+        b = b->hash_next;
+    }
+    return b;
+}
+
+static void hash_insert(bcache_buf_t *b)
+{
+    uint32_t h = b->blockno % BCACHE_HASH_SIZE;
+    b->hash_next = hash_table[h];
+    hash_table[h] = b;
+}
+
+static void hash_remove(bcache_buf_t *b)
+{
+    bcache_buf_t **pp = &hash_table[b->blockno % BCACHE_HASH_SIZE];
+    while (*pp)
+    {
+        if (*pp == b)
+        {
+            *pp = b->hash_next;
+            break;
+        }
+        pp = &(*pp)->hash_next;
+    }
+    b->hash_next = 0;
+    b->valid = 0;
+}
+
+/* ---- Write-back ---- */
+
+/* Write b and any directly following dirty blocks in one command */
+static int writeback_run(bcache_buf_t *b)
+{
+    uint8_t *vec[BCACHE_MAX_RUN];
+    bcache_buf_t *run[BCACHE_MAX_RUN];
+    uint32_t n = 0;
+
+    bcache_buf_t *cur = b;
+    while (cur && cur->valid && cur->dirty && n < BCACHE_MAX_RUN)
+    {
+        run[n] = cur;
+        vec[n] = cur->data;
+        n++;
+        cur = lookup(b->blockno + n);
+    }
+
+    if (ata_writev(b->blockno, n, vec) < 0)
+    {
+        return -1;
+    }
+    for (uint32_t i = 0; i < n; i++)
+    {
+        run[i]->dirty = 0;
+    }
+    stats.writebacks += n;
+    stats.dirty -= n;
+    return 0;
+}
+
+/* Take the least recently used unpinned buffer out of the cache */
+static bcache_buf_t *evict_one(void)
+{
+    for (bcache_buf_t *b = lru_tail; b; b = b->lru_prev)
+    {
+        if (b->refcnt)
+        {
+            continue;
+        }
+        if (b->dirty && writeback_run(b) < 0)
+        {
+            continue;
+        }
+        if (b->valid)
+        {
+            hash_remove(b);
+            stats.evictions++;
+        }
+        b->prefetched = 0;
+        b->ra_marker = 0;
+        return b;
+    }
+    return 0;
+}
+
+/* ---- Read-ahead ---- */
+
+/* Load up to ra_window uncached blocks starting at start in one command */
+static void readahead(uint32_t start)
+{
+    uint8_t *vec[BCACHE_MAX_RUN];
+    bcache_buf_t *run[BCACHE_MAX_RUN];
+    uint32_t limit = ra_window;
+    uint32_t n = 0;
+
+    if (limit > BCACHE_MAX_RUN)
+        limit = BCACHE_MAX_RUN;
+    if (limit > nbufs / 2)
+        limit = nbufs / 2;
+
+    while (n < limit && start + n < ata_sector_count() && !lookup(start + n))
+    {
+        bcache_buf_t *b = evict_one();
+        if (!b)
+        {
+            break;
+        }
+        b->blockno = start + n;
+        b->valid = 1;
+        hash_insert(b);
+        lru_touch(b);
+        run[n] = b;
+        vec[n] = b->data;
+        n++;
+    }
+    if (!n)
+    {
+        return;
+    }
+
+    if (ata_readv(start, n, vec) < 0)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            hash_remove(run[i]);
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < n; i++)
+    {
+        run[i]->prefetched = 1;
+    }
+    /* Reaching the middle of this window fetches the next one */
+    run[n / 2]->ra_marker = 1;
+    stats.readahead_blocks += n;
+}
+
+/* ---- Lookup ---- */
+
+static bcache_buf_t *get_block(uint32_t blockno, int fill)
+{
+    if (!nbufs || blockno >= ata_sector_count())
+    {
+        return 0;
+    }
+
+    int sequential = (blockno == last_block + 1);
+    last_block = blockno;
+
+    bcache_buf_t *b = lookup(blockno);
+    if (b)
+    {
+        stats.hits++;
+        if (b->prefetched)
+        {
+            b->prefetched = 0;
+            stats.readahead_hits++;
+        }
+        b->refcnt++;
+        lru_touch(b);
+        if (b->ra_marker)
+        {
+            b->ra_marker = 0;
+            uint32_t next = blockno + 1;
+            while (next < blockno + ra_window && lookup(next))
+            {
+                next++;
+            }
+            readahead(next);
+        }
+        return b;
+    }
+
+    stats.misses++;
+    b = evict_one();
+    if (!b)
+    {
+        return 0;
+    }
+    b->blockno = blockno;
+    b->refcnt = 1;
+    hash_insert(b);
+    lru_touch(b);
+
+    if (fill)
+    {
+        uint8_t *vec[1] = {b->data};
+        if (ata_readv(blockno, 1, vec) < 0)
+        {
+            hash_remove(b);
+            b->refcnt = 0;
+            return 0;
+        }
+    }
+    b->valid = 1;
+
+    if (sequential && ra_window > 1)
+    {
+        readahead(blockno + 1);
+    }
+    return b;
+}
+
+bcache_buf_t *bcache_get(uint32_t blockno)
+{
+    return get_block(blockno, 1);
+}
+
+void bcache_mark_dirty(bcache_buf_t *buf)
+{
+    if (buf && !buf->dirty)
+    {
+        buf->dirty = 1;
+        stats.dirty++;
+    }
+}
+
+void bcache_release(bcache_buf_t *buf)
+{
+    if (buf && buf->refcnt)
+    {
+        buf->refcnt--;
+    }
+}
+
+int bcache_read(uint32_t blockno, uint32_t offset, void *dst, uint32_t len)
+{
+    uint8_t *out = (uint8_t *)dst;
+    blockno += offset / BCACHE_BLOCK_SIZE;
+    offset %= BCACHE_BLOCK_SIZE;
+
+    while (len)
+    {
+        uint32_t chunk = BCACHE_BLOCK_SIZE - offset;
+        if (chunk > len)
+            chunk = len;
+        bcache_buf_t *b = bcache_get(blockno);
+        if (!b)
+        {
+            return -1;
+        }
+        memcpy(out, b->data + offset, chunk);
+        bcache_release(b);
+        out += chunk;
+        len -= chunk;
+        offset = 0;
+        blockno++;
+    }
+    return 0;
+}
+
+int bcache_write(uint32_t blockno, uint32_t offset, const void *src, uint32_t len)
+{
+    const uint8_t *in = (const uint8_t *)src;
+    blockno += offset / BCACHE_BLOCK_SIZE;
+    offset %= BCACHE_BLOCK_SIZE;
+
+    while (len)
+    {
+        uint32_t chunk = BCACHE_BLOCK_SIZE - offset;
+        if (chunk > len)
+            chunk = len;
+        /* A whole-block overwrite does not need the old contents */
+        bcache_buf_t *b = get_block(blockno, chunk != BCACHE_BLOCK_SIZE);
+        if (!b)
+        {
+            return -1;
+        }
+        memcpy(b->data + offset, in, chunk);
+        bcache_mark_dirty(b);
+        bcache_release(b);
+        in += chunk;
+        len -= chunk;
+        offset = 0;
+        blockno++;
+    }
+    return 0;
+}
+
+int bcache_sync(void)
+{
+    int rc = 0;
+    for (uint32_t i = 0; i < nbufs; i++)
+    {
+        if (bufs[i].valid && bufs[i].dirty)
+        {
+            /* Start each run at its lowest dirty block */
+            bcache_buf_t *b = &bufs[i];
+            bcache_buf_t *prev;
+            while (b->blockno && (prev = lookup(b->blockno - 1)) && prev->dirty)
+            {
+                b = prev;
+            }
+            if (writeback_run(b) < 0)
+            {
+                rc = -1;
+            }
+        }
+    }
+    return rc;
+}
+
+/* ---- Setup and tuning ---- */
+
+static void release_pool(void)
+{
+    if (bufs)
+        heap_free(bufs);
+    if (data_pool)
+        heap_free(data_pool);
+    bufs = 0;
+    data_pool = 0;
+    nbufs = 0;
+    lru_head = lru_tail = 0;
+    for (int i = 0; i < BCACHE_HASH_SIZE; i++)
+    {
+        hash_table[i] = 0;
+    }
+}
+
+int bcache_init(uint32_t count)
+{
+    release_pool();
+    if (!count)
+    {
+        return -1;
+    }
+
+    bufs = (bcache_buf_t *)heap_alloc(count * sizeof(bcache_buf_t));
+    data_pool = (uint8_t *)heap_alloc(count * BCACHE_BLOCK_SIZE);
+    if (!bufs || !data_pool)
+    {
+        release_pool();
+        return -1;
+    }
+
+    nbufs = count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bcache_buf_t *b = &bufs[i];
+        b->blockno = 0;
+        b->valid = 0;
+        b->dirty = 0;
+        b->prefetched = 0;
+        b->ra_marker = 0;
+        b->refcnt = 0;
+        b->hash_next = 0;
+        b->data = data_pool + i * BCACHE_BLOCK_SIZE;
+        lru_push_front(b);
+    }
+    last_block = 0xFFFFFFFF;
+    stats.dirty = 0;
+    return 0;
+}
+
+int bcache_resize(uint32_t count)
+{
+    uint32_t old = nbufs;
+    for (uint32_t i = 0; i < nbufs; i++)
+    {
+        if (bufs[i].refcnt)
+        {
+            return -1;
+        }
+    }
+    if (!count || bcache_sync() < 0)
+    {
+        return -1;
+    }
+    if (bcache_init(count) < 0)
+    {
+        /* Fall back to the previous size so the disk stays usable */
+        if (old)
+            bcache_init(old);
+        return -1;
+    }
+    return 0;
+}
+
+void bcache_set_readahead(uint32_t blocks)
+{
+    ra_window = blocks;
+}
+
+void bcache_get_stats(bcache_stats_t *out)
+{
+    if (!out)
+    {
+        return;
+    }
+    *out = stats;
+    out->nbufs = nbufs;
+    out->readahead_window = ra_window;
+}
+
+void bcache_reset_stats(void)
+{
+    uint32_t dirty = stats.dirty;
+    stats.hits = stats.misses = 0;
+    stats.readahead_blocks = stats.readahead_hits = 0;
+    stats.writebacks = stats.evictions = 0;
+    stats.dirty = dirty;
+}
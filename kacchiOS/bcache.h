@@ -0,0 +1,54 @@
+/* bcache.h - Block buffer cache (LRU, write-back, sequential read-ahead) */
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "types.h"
+#include "ata.h"
+
+#define BCACHE_BLOCK_SIZE ATA_SECTOR_SIZE
+#define BCACHE_DEFAULT_BUFS 32
+#define BCACHE_DEFAULT_READAHEAD 8
+
+typedef struct bcache_buf
+{
+    uint32_t blockno;
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t prefetched; /* loaded by read-ahead, not yet referenced */
+    uint8_t ra_marker;  /* hitting this block triggers the next window */
+    uint32_t refcnt;
+    struct bcache_buf *lru_prev; /* head of the LRU list is most recent */
+    struct bcache_buf *lru_next;
+    struct bcache_buf *hash_next;
+    uint8_t *data;
+} bcache_buf_t;
+
+typedef struct bcache_stats
+{
+    uint32_t nbufs;
+    uint32_t readahead_window;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead_blocks; /* blocks fetched speculatively */
+    uint32_t readahead_hits;   /* of those, blocks later referenced */
+    uint32_t writebacks;       /* blocks written to disk */
+    uint32_t evictions;
+    uint32_t dirty;
+} bcache_stats_t;
+
+int bcache_init(uint32_t nbufs);
+int bcache_resize(uint32_t nbufs);
+void bcache_set_readahead(uint32_t blocks);
+
+bcache_buf_t *bcache_get(uint32_t blockno);
+void bcache_mark_dirty(bcache_buf_t *buf);
+void bcache_release(bcache_buf_t *buf);
+
+int bcache_read(uint32_t blockno, uint32_t offset, void *dst, uint32_t len);
+int bcache_write(uint32_t blockno, uint32_t offset, const void *src, uint32_t len);
+int bcache_sync(void);
+
+void bcache_get_stats(bcache_stats_t *out);
+void bcache_reset_stats(void);
+
+#endif
@@ -0,0 +1,300 @@
+/* bench.c - rdtsc-based microbenchmarks of the kernel's hot paths
+ *
+ * Each benchmark collects per-operation cycle counts and reports
+ *     BENCH <name> samples=<n> min=<c> median=<c> p99=<c>
+ * so 'make bench' output can be parsed and compared across builds.
+ * Any other ready process (heartbeat, shell) is part of the round trip
+ * for the scheduler and IPC benchmarks; 'make bench' boots with only the
+ * benchmark running.
+ */
+#include "bench.h"
+#include "cpu.h"
+#include "io.h"
+#include "ipc.h"
+#include "memory.h"
+#include "process.h"
+#include "scheduler.h"
+#include "serial.h"
+
+#define PARTNER_STACK 1024
+#define HELPER_STACK 1024
+#define HEAP_SLOTS 32
+#define IPC_STOP 0xFFFFFFFE /* ~0 cannot survive the direct handoff */
+
+extern void context_switch(context_t *old_ctx, context_t *new_ctx);
+
+static uint32_t samples[BENCH_MAX_SAMPLES];
+static uint32_t free_samples[BENCH_MAX_SAMPLES];
+static uint32_t rng_state = 12345;
+
+static volatile int helpers_stop = 0;
+static volatile int helpers_live = 0;
+
+static context_t bench_ctx;
+static context_t partner_ctx;
+
+static ipc_queue_t ping_queue;
+static ipc_queue_t pong_queue;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1103515245u + 12345u;
+    return rng_state >> 8;
+}
+
+static uint32_t cycles_since(uint64_t start)
+{
+    uint64_t delta = rdtsc() - start;
+    return delta > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)delta;
+}
+
+static void sort_samples(uint32_t n)
+{
+    for (uint32_t i = 1; i < n; i++)
+    {
+        uint32_t v = samples[i];
+        uint32_t j = i;
+        while (j > 0 && samples[j - 1] > v)
+        {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = v;
+    }
+}
+
+static void report(const char *name, uint32_t n)
+{
+    bench_result_t r;
+    sort_samples(n);
+    r.name = name;
+    r.samples = n;
+    r.min = n ? samples[0] : 0;
+    r.median = n ? samples[n / 2] : 0;
+    r.p99 = n ? samples[(n * 99) / 100] : 0;
+
+    serial_puts("BENCH ");
+    serial_puts(r.name);
+    serial_puts(" samples=");
+    serial_putu(r.samples);
+    serial_puts(" min=");
+    serial_putu(r.min);
+    serial_puts(" median=");
+    serial_putu(r.median);
+    serial_puts(" p99=");
+    serial_putu(r.p99);
+    serial_puts("\n");
+}
+
+/* ---- context_switch round trip ---- */
+
+static void partner_loop(void)
+{
+    for (;;)
+    {
+        context_switch(&partner_ctx, &bench_ctx);
+    }
+}
+
+static void bench_context_switch(void)
+{
+    uint8_t *stack = (uint8_t *)heap_alloc(PARTNER_STACK);
+    if (!stack)
+    {
+        serial_puts("# ctx_switch: no memory\n");
+        return;
+    }
+    uint32_t *sp = (uint32_t *)(stack + PARTNER_STACK);
+    *(--sp) = 0; /* fake return address */
+    partner_ctx.esp = (uint32_t)sp;
+    partner_ctx.ebp = (uint32_t)sp;
+    partner_ctx.eip = (uint32_t)partner_loop;
+
+    for (uint32_t i = 0; i < BENCH_MAX_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc();
+        context_switch(&bench_ctx, &partner_ctx);
+        samples[i] = cycles_since(t0);
+    }
+    heap_free(stack);
+    report("ctx_switch_roundtrip", BENCH_MAX_SAMPLES);
+}
+
+/* ---- scheduler_yield with N ready processes ---- */
+
+static void yield_helper(void *arg)
+{
+    (void)arg;
+    while (!helpers_stop)
+    {
+        scheduler_yield();
+    }
+    helpers_live--;
+}
+
+static void stop_helpers(void)
+{
+    helpers_stop = 1;
+    while (helpers_live)
+    {
+        scheduler_yield();
+    }
+    helpers_stop = 0;
+}
+
+static void bench_yield(uint32_t ready, const char *name)
+{
+    for (uint32_t i = 1; i < ready; i++)
+    {
+        if (!process_create(yield_helper, 0, HELPER_STACK))
+        {
+            serial_puts("# yield: process table full\n");
+            stop_helpers();
+            return;
+        }
+        helpers_live++;
+    }
+
+    for (uint32_t i = 0; i < BENCH_MAX_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc();
+        scheduler_yield();
+        samples[i] = cycles_since(t0);
+    }
+    stop_helpers();
+    report(name, BENCH_MAX_SAMPLES);
+}
+
+/* ---- heap_alloc / heap_free with mixed sizes ---- */
+
+static uint32_t mixed_size(void)
+{
+    uint32_t r = rng_next() % 100;
+    if (r < 60)
+        return 16 + rng_next() % 112; /* small objects */
+    if (r < 90)
+        return 128 + rng_next() % 896; /* buffers */
+    return 1024 + rng_next() % 3072;   /* stacks and large blocks */
+}
+
+static void bench_heap(void)
+{
+    void *slots[HEAP_SLOTS];
+    uint32_t n_alloc = 0, n_free = 0;
+
+    for (int i = 0; i < HEAP_SLOTS; i++)
+    {
+        slots[i] = 0;
+    }
+
+    for (uint32_t i = 0; n_alloc < BENCH_MAX_SAMPLES && i < BENCH_MAX_SAMPLES * 4; i++)
+    {
+        uint32_t slot = rng_next() % HEAP_SLOTS;
+        if (slots[slot])
+        {
+            uint64_t t0 = rdtsc();
+            heap_free(slots[slot]);
+            uint32_t dt = cycles_since(t0);
+            if (n_free < BENCH_MAX_SAMPLES)
+                free_samples[n_free++] = dt;
+            slots[slot] = 0;
+        }
+        else
+        {
+            uint32_t size = mixed_size();
+            uint64_t t0 = rdtsc();
+            slots[slot] = heap_alloc(size);
+            samples[n_alloc++] = cycles_since(t0);
+        }
+    }
+    for (int i = 0; i < HEAP_SLOTS; i++)
+    {
+        heap_free(slots[i]);
+    }
+    report("heap_alloc_mixed", n_alloc);
+
+    for (uint32_t i = 0; i < n_free; i++)
+    {
+        samples[i] = free_samples[i];
+    }
+    report("heap_free_mixed", n_free);
+}
+
+/* ---- ipc_send / ipc_recv ping-pong ---- */
+
+static void ipc_partner(void *arg)
+{
+    (void)arg;
+    uint32_t v;
+    while (1)
+    {
+        ipc_recv(&ping_queue, &v);
+        if (v == IPC_STOP)
+        {
+            break;
+        }
+        ipc_send(&pong_queue, v);
+    }
+    helpers_live--;
+}
+
+static void bench_ipc(void)
+{
+    ipc_init(&ping_queue);
+    ipc_init(&pong_queue);
+    if (!process_create(ipc_partner, 0, HELPER_STACK))
+    {
+        serial_puts("# ipc: process table full\n");
+        return;
+    }
+    helpers_live++;
+
+    uint32_t v;
+    for (uint32_t i = 0; i < BENCH_MAX_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc();
+        ipc_send(&ping_queue, i);
+        ipc_recv(&pong_queue, &v);
+        samples[i] = cycles_since(t0);
+    }
+    ipc_send(&ping_queue, IPC_STOP);
+    stop_helpers();
+    report("ipc_pingpong", BENCH_MAX_SAMPLES);
+}
+
+/* ---- serial output ---- */
+
+static void bench_serial(void)
+{
+    /* 64-byte comment lines so parsers can skip them */
+    static const char line[] =
+        "# ............................................................\n";
+    const uint32_t n = 32;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t t0 = rdtsc();
+        serial_puts(line);
+        samples[i] = cycles_since(t0);
+    }
+    report("serial_64B_line", n);
+}
+
+void bench_run_all(void)
+{
+    serial_puts("# kacchiOS microbenchmarks (cycles per operation)\n");
+    bench_context_switch();
+    bench_yield(1, "yield_ready1");
+    bench_yield(2, "yield_ready2");
+    bench_yield(4, "yield_ready4");
+    bench_heap();
+    bench_ipc();
+    bench_serial();
+    serial_puts("# done\n");
+}
+
+void bench_qemu_exit(uint32_t code)
+{
+    /* QEMU exits with status (code << 1) | 1; without the device this is a no-op */
+    serial_flush();
+    outl(BENCH_DEBUG_EXIT_PORT, code);
+}
@@ -0,0 +1,22 @@
+/* bench.h - In-kernel rdtsc microbenchmarks */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "types.h"
+
+#define BENCH_MAX_SAMPLES 512
+#define BENCH_DEBUG_EXIT_PORT 0xF4 /* QEMU isa-debug-exit */
+
+typedef struct bench_result
+{
+    const char *name;
+    uint32_t samples;
+    uint32_t min;
+    uint32_t median;
+    uint32_t p99;
+} bench_result_t;
+
+void bench_run_all(void);
+void bench_qemu_exit(uint32_t code);
+
+#endif
@@ -0,0 +1,60 @@
+/* bootprof.c - Record and print where boot time goes
+ *
+ * boot.S stores the TSC in boot_entry_tsc before touching anything else,
+ * so the first phase includes the BSS clear. Marks are cheap (one rdtsc
+ * and a table store); conversion to microseconds only happens when the
+ * 'boot' command asks for the report.
+ */
+#include "bootprof.h"
+#include "cpu.h"
+#include "serial.h"
+#include "string.h"
+#include "tsc.h"
+
+extern uint64_t boot_entry_tsc; /* written by boot.S */
+
+static struct
+{
+    const char *phase;
+    uint64_t tsc;
+} marks[BOOTPROF_MAX_MARKS];
+static uint32_t mark_count = 0;
+
+void bootprof_mark(const char *phase)
+{
+    if (mark_count < BOOTPROF_MAX_MARKS)
+    {
+        marks[mark_count].phase = phase;
+        marks[mark_count].tsc = rdtsc();
+        mark_count++;
+    }
+}
+
+uint64_t bootprof_total_cycles(void)
+{
+    return mark_count ? marks[mark_count - 1].tsc - boot_entry_tsc : 0;
+}
+
+void bootprof_report(void)
+{
+    uint64_t prev = boot_entry_tsc;
+    serial_puts("PHASE                 CYCLES      US\n");
+    for (uint32_t i = 0; i < mark_count; i++)
+    {
+        uint64_t delta = marks[i].tsc - prev;
+        uint32_t len = strlen(marks[i].phase);
+        serial_puts(marks[i].phase);
+        do
+        {
+            serial_putc(' ');
+        } while (++len < 22);
+        serial_putu(delta > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)delta);
+        serial_puts("  ");
+        serial_putu(tsc_cycles_to_us(delta));
+        serial_puts("\n");
+        prev = marks[i].tsc;
+    }
+    serial_puts("entry to first process: ");
+    serial_putu(tsc_cycles_to_us(bootprof_total_cycles()));
+    serial_puts(" us\n");
+}
@@ -0,0 +1,17 @@
+/* bootprof.h - TSC timestamps of the boot sequence */
+#ifndef BOOTPROF_H
+#define BOOTPROF_H
+
+#include "types.h"
+
+#define BOOTPROF_MAX_MARKS 24
+
+/* Stamp the end of a boot phase; phase must be a string literal */
+void bootprof_mark(const char *phase);
+
+/* Cycles from the multiboot entry point to the last mark */
+uint64_t bootprof_total_cycles(void);
+
+void bootprof_report(void);
+
+#endif
@@ -0,0 +1,151 @@
+/* cpu.h - CPU feature detection and model-specific registers */
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+
+#define CPUID_EDX_TSC (1u << 4)
+#define CPUID_EDX_MSR (1u << 5)
+#define CPUID_EDX_SEP (1u << 11)
+#define CPUID_EDX_FXSR (1u << 24)
+#define CPUID_EDX_SSE (1u << 25)
+#define CPUID_EDX_SSE2 (1u << 26)
+
+#define CR0_MP (1u << 1)
+#define CR0_EM (1u << 2)
+#define CR0_WP (1u << 16)
+#define CR0_PG (1u << 31)
+#define CR4_PSE (1u << 4)
+#define CR4_OSFXSR (1u << 9)
+#define CR4_OSXMMEXCPT (1u << 10)
+
+static inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d)
+{
+    __asm__ volatile("cpuid"
+                     : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d)
+                     : "a"(leaf), "c"(0));
+}
+
+static inline uint32_t cpuid_edx(uint32_t leaf)
+{
+    uint32_t a, b, c, d;
+    cpuid(leaf, &a, &b, &c, &d);
+    return d;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint32_t read_cr0(void)
+{
+    uint32_t v;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v)
+{
+    __asm__ volatile("mov %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr4(void)
+{
+    uint32_t v;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v)
+{
+    __asm__ volatile("mov %0, %%cr4" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr2(void)
+{
+    uint32_t v;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr3(uint32_t v)
+{
+    __asm__ volatile("mov %0, %%cr3" : : "r"(v) : "memory");
+}
+
+static inline void invlpg(uint32_t addr)
+{
+    __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Interrupt-off critical sections that nest: restore what was there */
+#ifdef KACCHI_HOST
+static inline uint32_t irq_save(void)
+{
+    return 0; /* the hosted build takes no interrupts */
+}
+
+static inline void irq_restore(uint32_t flags)
+{
+    (void)flags;
+}
+
+/* Stop for good after unrecoverable corruption; host/stubs.c aborts */
+void cpu_halt(void) __attribute__((noreturn));
+#else
+#define EFLAGS_IF (1u << 9)
+
+static inline uint32_t irq_save(void)
+{
+    uint32_t flags;
+    __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags)
+{
+    if (flags & EFLAGS_IF)
+    {
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+/* Stop for good after unrecoverable corruption */
+static inline __attribute__((noreturn)) void cpu_halt(void)
+{
+    for (;;)
+    {
+        __asm__ volatile("cli; hlt");
+    }
+}
+#endif
+
+/* 64-by-32 division without libgcc: two divl steps keep each quotient
+   within 32 bits */
+static inline uint64_t udiv64_32(uint64_t n, uint32_t d)
+{
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t lo = (uint32_t)n;
+    uint32_t q_hi = hi / d;
+    uint32_t r = hi % d;
+    uint32_t q_lo;
+    __asm__("divl %4" : "=a"(q_lo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+#endif
@@ -0,0 +1,132 @@
+/* defer.c - Softirq and kworker queues for interrupt bottom halves
+ *
+ * The queues live in percpu_t. Interrupts are only disabled to link an
+ * item in or to detach the whole list; the handlers themselves always
+ * run with interrupts enabled.
+ */
+#include "defer.h"
+#include "cpu.h"
+#include "process.h"
+#include "scheduler.h"
+
+#define KWORKER_STACK 2048
+
+static process_t *kworker = 0;
+static int kworker_sleeping = 0;
+static work_t kworker_wake;
+
+void work_init(work_t *work, work_fn_t fn, int thread)
+{
+    work->fn = fn;
+    work->next = 0;
+    work->pending = 0;
+    work->thread = thread ? 1 : 0;
+}
+
+static void append(work_t **head, work_t **tail, work_t *work)
+{
+    work->next = 0;
+    if (*tail)
+    {
+        (*tail)->next = work;
+    }
+    else
+    {
+        *head = work;
+    }
+    *tail = work;
+}
+
+void work_queue(work_t *work)
+{
+    percpu_t *cpu = this_cpu->self;
+    uint32_t flags = irq_save();
+    percpu_inc(work_queued);
+    if (work->pending++)
+    {
+        percpu_inc(work_coalesced);
+        irq_restore(flags);
+        return;
+    }
+    if (work->thread)
+    {
+        append(&cpu->thread_head, &cpu->thread_tail, work);
+        if (kworker && !kworker_wake.pending)
+        {
+            kworker_wake.pending = 1;
+            append(&cpu->softirq_head, &cpu->softirq_tail, &kworker_wake);
+        }
+    }
+    else
+    {
+        append(&cpu->softirq_head, &cpu->softirq_tail, work);
+    }
+    irq_restore(flags);
+}
+
+/* Detach a list and run it; items queued meanwhile wait for the next pass */
+static void run_list(work_t **head, work_t **tail)
+{
+    uint32_t flags = irq_save();
+    work_t *work = *head;
+    *head = *tail = 0;
+    irq_restore(flags);
+
+    while (work)
+    {
+        flags = irq_save();
+        work_t *next = work->next;
+        uint32_t count = work->pending;
+        work->pending = 0;
+        irq_restore(flags);
+
+        work->fn(work, count);
+        percpu_inc(work_run);
+        work = next;
+    }
+}
+
+void softirq_run(void)
+{
+    percpu_t *cpu = this_cpu->self;
+    percpu_inc(softirq_passes);
+    run_list(&cpu->softirq_head, &cpu->softirq_tail);
+}
+
+static void wake_kworker(work_t *work, uint32_t count)
+{
+    (void)work;
+    (void)count;
+    if (kworker_sleeping)
+    {
+        kworker_sleeping = 0;
+        scheduler_unblock(kworker);
+    }
+}
+
+static void kworker_process(void *arg)
+{
+    (void)arg;
+    percpu_t *cpu = this_cpu->self;
+    while (1)
+    {
+        run_list(&cpu->thread_head, &cpu->thread_tail);
+
+        uint32_t flags = irq_save();
+        if (cpu->thread_head)
+        {
+            irq_restore(flags);
+            continue;
+        }
+        /* Anything queued from here on goes through kworker_wake */
+        kworker_sleeping = 1;
+        irq_restore(flags);
+        process_block_current();
+    }
+}
+
+void defer_start_worker(void)
+{
+    work_init(&kworker_wake, wake_kworker, 0);
+    kworker = process_create(kworker_process, 0, KWORKER_STACK);
+}
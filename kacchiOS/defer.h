@@ -0,0 +1,41 @@
+/* defer.h - Deferred work: bottom halves queued by interrupt handlers
+ *
+ * A top half calls work_queue() and returns. Softirq items run at the
+ * next scheduling point (scheduler_yield/block/exit), where no scheduler
+ * or IPC state is half updated, so they may wake processes but must not
+ * block. Thread items run in the kworker process and may block or yield.
+ * Queueing an item that is still pending only bumps its count, so a
+ * burst of interrupts costs one run of the handler.
+ */
+#ifndef DEFER_H
+#define DEFER_H
+
+#include "types.h"
+#include "percpu.h"
+
+struct work;
+typedef void (*work_fn_t)(struct work *work, uint32_t count);
+
+typedef struct work
+{
+    work_fn_t fn;
+    struct work *next;
+    uint32_t pending; /* times queued since the last run; 0 when idle */
+    uint32_t thread;  /* run in the kworker instead of at a scheduling point */
+} work_t;
+
+void work_init(work_t *work, work_fn_t fn, int thread);
+void work_queue(work_t *work);
+void defer_start_worker(void);
+void softirq_run(void);
+
+/* Scheduling points call this; one %gs load when nothing is queued */
+static inline void softirq_poll(void)
+{
+    if (this_cpu->softirq_head)
+    {
+        softirq_run();
+    }
+}
+
+#endif
@@ -0,0 +1,380 @@
+/* fiber.c - Per-process fiber run loop
+ *
+ * The loop's state hangs off process_t.fibers while fiber_run is
+ * active or fibers have been created. Ready fibers form a FIFO; fibers
+ * waiting in fiber_join are referenced only by the fiber they join, and
+ * fibers waiting for IPC sit on the parked list until a message shows up.
+ * Every fiber not yet released is also on the loop's all list, so a run
+ * loop that stops with fibers joined on each other can still free them.
+ */
+#include "fiber.h"
+#include "cpu.h"
+#include "memory.h"
+#include "process.h"
+#include "scheduler.h"
+#include "serial.h"
+
+#define FIBER_CANARY 0xF1BE2CA5u
+
+typedef enum
+{
+    FIBER_READY,
+    FIBER_RUNNING,
+    FIBER_JOINING,
+    FIBER_PARKED,
+    FIBER_DONE
+} fiber_state_t;
+
+struct fiber
+{
+    context_t ctx;
+    fiber_state_t state;
+    fiber_fn_t fn;
+    void *arg;
+    struct fiber *next;
+    struct fiber *all_prev; /* loop's all list */
+    struct fiber *all_next;
+    struct fiber *joiner;
+    ipc_queue_t *wait_queue;
+    uint32_t *wait_out;
+    uint8_t detached;
+    uint8_t started;
+    size_t stack_size;
+    /* stack follows; its lowest word holds FIBER_CANARY */
+};
+
+typedef struct fiber_loop
+{
+    context_t ctx; /* the process side of every switch */
+    fiber_t *current;
+    fiber_t *ready_head;
+    fiber_t *ready_tail;
+    fiber_t *parked;
+    fiber_t *finished; /* done, joinable, not yet joined */
+    fiber_t *all;      /* every fiber not yet released */
+    uint32_t live;
+} fiber_loop_t;
+
+extern void context_switch(context_t *old_ctx, context_t *new_ctx);
+
+static fiber_loop_t *current_loop(int create)
+{
+    process_t *self = process_current();
+    if (!self)
+    {
+        return 0;
+    }
+    if (!self->fibers && create)
+    {
+        fiber_loop_t *loop = (fiber_loop_t *)heap_alloc(sizeof(fiber_loop_t));
+        if (!loop)
+        {
+            return 0;
+        }
+        loop->current = 0;
+        loop->ready_head = loop->ready_tail = 0;
+        loop->parked = 0;
+        loop->finished = 0;
+        loop->all = 0;
+        loop->live = 0;
+        self->fibers = loop;
+    }
+    return (fiber_loop_t *)self->fibers;
+}
+
+static uint8_t *stack_base(fiber_t *f)
+{
+    return (uint8_t *)(f + 1);
+}
+
+static void make_ready(fiber_loop_t *loop, fiber_t *f)
+{
+    f->state = FIBER_READY;
+    f->next = 0;
+    if (loop->ready_tail)
+    {
+        loop->ready_tail->next = f;
+    }
+    else
+    {
+        loop->ready_head = f;
+    }
+    loop->ready_tail = f;
+}
+
+/* Hand the CPU back to fiber_run; returns when this fiber is resumed */
+static void switch_to_loop(fiber_loop_t *loop, fiber_t *self)
+{
+    context_switch(&self->ctx, &loop->ctx);
+}
+
+static void fiber_trampoline(fiber_t *self)
+{
+    self->fn(self->arg);
+    self->state = FIBER_DONE;
+    switch_to_loop((fiber_loop_t *)process_current()->fibers, self);
+}
+
+size_t fiber_footprint(size_t stack_size)
+{
+    if (stack_size < FIBER_MIN_STACK)
+    {
+        stack_size = FIBER_MIN_STACK;
+    }
+    return sizeof(fiber_t) + ((stack_size + 15) & ~(size_t)15);
+}
+
+fiber_t *fiber_create(fiber_fn_t fn, void *arg, size_t stack_size)
+{
+    fiber_loop_t *loop = current_loop(1);
+    if (!fn || !loop)
+    {
+        return 0;
+    }
+    if (!stack_size)
+    {
+        stack_size = FIBER_DEFAULT_STACK;
+    }
+    size_t total = fiber_footprint(stack_size);
+    fiber_t *f = (fiber_t *)heap_alloc(total);
+    if (!f)
+    {
+        return 0;
+    }
+
+    f->fn = fn;
+    f->arg = arg;
+    f->joiner = 0;
+    f->wait_queue = 0;
+    f->wait_out = 0;
+    f->detached = 0;
+    f->started = 0;
+    f->stack_size = total - sizeof(fiber_t);
+    *(uint32_t *)stack_base(f) = FIBER_CANARY;
+    f->all_prev = 0;
+    f->all_next = loop->all;
+    if (loop->all)
+    {
+        loop->all->all_prev = f;
+    }
+    loop->all = f;
+
+    /* Same initial frame as a process: argument above a fake return */
+    uintptr_t *sp = (uintptr_t *)(stack_base(f) + f->stack_size);
+#ifdef KACCHI_HOST
+    *(--sp) = 0; /* keep the x86-64 ABI's 16-byte alignment at entry */
+#endif
+    *(--sp) = (uintptr_t)f;
+    *(--sp) = 0;
+    f->ctx.esp = (uintptr_t)sp;
+    f->ctx.ebp = (uintptr_t)sp;
+    f->ctx.eip = (uintptr_t)fiber_trampoline;
+
+    loop->live++;
+    make_ready(loop, f);
+    return f;
+}
+
+void fiber_detach(fiber_t *fiber)
+{
+    if (fiber)
+    {
+        fiber->detached = 1;
+    }
+}
+
+void fiber_yield(void)
+{
+    fiber_loop_t *loop = current_loop(0);
+    fiber_t *self = loop ? loop->current : 0;
+    if (!self)
+    {
+        scheduler_yield();
+        return;
+    }
+    make_ready(loop, self);
+    switch_to_loop(loop, self);
+}
+
+static void release(fiber_loop_t *loop, fiber_t *f)
+{
+    if (f->all_prev)
+    {
+        f->all_prev->all_next = f->all_next;
+    }
+    else
+    {
+        loop->all = f->all_next;
+    }
+    if (f->all_next)
+    {
+        f->all_next->all_prev = f->all_prev;
+    }
+    heap_free(f);
+}
+
+static void unlink_finished(fiber_loop_t *loop, fiber_t *f)
+{
+    fiber_t **pp = &loop->finished;
+    while (*pp && *pp != f)
+    {
+        pp = &(*pp)->next;
+    }
+    if (*pp)
+    {
+        *pp = f->next;
+    }
+}
+
+int fiber_join(fiber_t *fiber)
+{
+    fiber_loop_t *loop = current_loop(0);
+    fiber_t *self = loop ? loop->current : 0;
+    if (!self || !fiber || fiber == self || fiber->detached || fiber->joiner)
+    {
+        return -1;
+    }
+    if (fiber->state != FIBER_DONE)
+    {
+        fiber->joiner = self;
+        self->state = FIBER_JOINING;
+        switch_to_loop(loop, self);
+    }
+    unlink_finished(loop, fiber);
+    release(loop, fiber);
+    return 0;
+}
+
+int fiber_ipc_recv(ipc_queue_t *q, uint32_t *out_value)
+{
+    fiber_loop_t *loop = current_loop(0);
+    fiber_t *self = loop ? loop->current : 0;
+    if (!self)
+    {
+        return ipc_recv(q, out_value);
+    }
+    if (!q || !out_value)
+    {
+        return -1;
+    }
+    if (ipc_try_recv(q, out_value) == 0)
+    {
+        return 0;
+    }
+    self->state = FIBER_PARKED;
+    self->wait_queue = q;
+    self->wait_out = out_value;
+    self->next = loop->parked;
+    loop->parked = self;
+    switch_to_loop(loop, self); /* the loop stores the message before resuming us */
+    return 0;
+}
+
+/* Move every parked fiber whose queue has a message to the ready list */
+static int poll_parked(fiber_loop_t *loop)
+{
+    int woke = 0;
+    fiber_t **pp = &loop->parked;
+    while (*pp)
+    {
+        fiber_t *f = *pp;
+        if (ipc_try_recv(f->wait_queue, f->wait_out) == 0)
+        {
+            *pp = f->next;
+            f->wait_queue = 0;
+            make_ready(loop, f);
+            woke = 1;
+        }
+        else
+        {
+            pp = &f->next;
+        }
+    }
+    return woke;
+}
+
+static void finish(fiber_loop_t *loop, fiber_t *f)
+{
+    loop->live--;
+    if (f->joiner)
+    {
+        make_ready(loop, f->joiner); /* fiber_join frees f */
+    }
+    else if (f->detached)
+    {
+        release(loop, f);
+    }
+    else
+    {
+        f->next = loop->finished;
+        loop->finished = f;
+    }
+}
+
+uint32_t fiber_run(void)
+{
+    fiber_loop_t *loop = current_loop(0);
+    if (!loop || loop->current)
+    {
+        return 0; /* nothing created, or called from inside a fiber */
+    }
+
+    uint32_t ran = 0;
+    while (loop->live)
+    {
+        fiber_t *f = loop->ready_head;
+        if (!f)
+        {
+            if (!loop->parked)
+            {
+                break; /* only joins on each other remain: deadlock */
+            }
+            if (!poll_parked(loop))
+            {
+                scheduler_yield(); /* let the senders run */
+            }
+            continue;
+        }
+
+        loop->ready_head = f->next;
+        if (!loop->ready_head)
+        {
+            loop->ready_tail = 0;
+        }
+        if (!f->started)
+        {
+            f->started = 1;
+            ran++;
+        }
+        f->state = FIBER_RUNNING;
+        loop->current = f;
+        context_switch(&loop->ctx, &f->ctx);
+        loop->current = 0;
+
+        if (*(uint32_t *)stack_base(f) != FIBER_CANARY)
+        {
+            /* The overflow ran through the control block below the stack
+             * and on into the heap: nothing here can be trusted now */
+            serial_puts("fiber: stack overflow, halting\n");
+            serial_flush();
+            cpu_halt();
+        }
+        if (f->state == FIBER_DONE)
+        {
+            finish(loop, f);
+        }
+    }
+
+    if (loop->live)
+    {
+        serial_puts("fiber: run loop stopped with fibers waiting on each other\n");
+    }
+    /* Finished but unjoined, plus any stuck in that deadlock */
+    while (loop->all)
+    {
+        release(loop, loop->all);
+    }
+    process_current()->fibers = 0;
+    heap_free(loop);
+    return ran;
+}
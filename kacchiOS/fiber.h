@@ -0,0 +1,46 @@
+/* fiber.h - Cooperative fibers inside a process
+ *
+ * Fibers share their process's slot in the process table and switch
+ * with the same context_switch/context_t as processes, without going
+ * through the scheduler. A process creates fibers, then calls
+ * fiber_run(), which runs them round-robin until all have finished.
+ *
+ * Each fiber is one heap block: the control block followed by its
+ * stack. Interrupts arrive on whatever stack is current, so stacks
+ * below FIBER_MIN_STACK are rounded up. A fiber that overflows its stack
+ * has already overwritten its control block, so the run loop halts.
+ */
+#ifndef FIBER_H
+#define FIBER_H
+
+#include "types.h"
+#include "ipc.h"
+
+#define FIBER_DEFAULT_STACK 512
+#define FIBER_MIN_STACK 256
+
+typedef void (*fiber_fn_t)(void *arg);
+typedef struct fiber fiber_t;
+
+/* Joinable until fiber_join or fiber_detach; unjoined fibers that have
+ * finished are released when fiber_run returns */
+fiber_t *fiber_create(fiber_fn_t fn, void *arg, size_t stack_size);
+void fiber_detach(fiber_t *fiber);
+
+/* From a fiber: let the next one run. From plain process code: scheduler_yield */
+void fiber_yield(void);
+
+/* Wait for fiber to finish, then release it; returns -1 outside a fiber */
+int fiber_join(fiber_t *fiber);
+
+/* Like ipc_recv, but an empty queue parks only the calling fiber; the
+ * run loop polls parked fibers and yields the process while none can run */
+int fiber_ipc_recv(ipc_queue_t *q, uint32_t *out_value);
+
+/* Run this process's fibers until none remain; returns how many ran */
+uint32_t fiber_run(void);
+
+/* Bytes of heap used per fiber for a given stack size */
+size_t fiber_footprint(size_t stack_size);
+
+#endif
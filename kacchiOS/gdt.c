@@ -0,0 +1,86 @@
+/* gdt.c - Flat segments for ring 0 and ring 3, plus a single TSS */
+#include "gdt.h"
+
+#define GDT_ENTRIES 7
+
+typedef struct gdt_entry
+{
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t base_mid;
+    uint8_t access;
+    uint8_t granularity; /* flags in the high nibble, limit 19:16 low */
+    uint8_t base_high;
+} __attribute__((packed)) gdt_entry_t;
+
+typedef struct gdt_ptr
+{
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_ptr_t;
+
+static gdt_entry_t gdt[GDT_ENTRIES];
+static gdt_ptr_t gdt_desc;
+static tss_t tss;
+
+static void set_entry(int idx, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags)
+{
+    gdt[idx].limit_low = limit & 0xFFFF;
+    gdt[idx].base_low = base & 0xFFFF;
+    gdt[idx].base_mid = (base >> 16) & 0xFF;
+    gdt[idx].access = access;
+    gdt[idx].granularity = (flags & 0xF0) | ((limit >> 16) & 0x0F);
+    gdt[idx].base_high = (base >> 24) & 0xFF;
+}
+
+void gdt_init(void)
+{
+    set_entry(0, 0, 0, 0, 0);
+    set_entry(GDT_KERNEL_CODE / 8, 0, 0xFFFFF, 0x9A, 0xC0); /* ring 0 code */
+    set_entry(GDT_KERNEL_DATA / 8, 0, 0xFFFFF, 0x92, 0xC0); /* ring 0 data */
+    set_entry(GDT_USER_CODE / 8, 0, 0xFFFFF, 0xFA, 0xC0);   /* ring 3 code */
+    set_entry(GDT_USER_DATA / 8, 0, 0xFFFFF, 0xF2, 0xC0);   /* ring 3 data */
+
+    /* No I/O bitmap: with IOPL 0 every port access from ring 3 faults */
+    tss.ss0 = GDT_KERNEL_DATA;
+    tss.esp0 = 0;
+    tss.iomap_base = sizeof(tss_t);
+    set_entry(GDT_TSS / 8, (uint32_t)&tss, sizeof(tss_t) - 1, 0x89, 0x00);
+
+    gdt_desc.limit = sizeof(gdt) - 1;
+    gdt_desc.base = (uint32_t)gdt;
+
+    __asm__ volatile("lgdt %0\n\t"
+                     "ljmp %1, $1f\n"
+                     "1:\n\t"
+                     "mov %2, %%ax\n\t"
+                     "mov %%ax, %%ds\n\t"
+                     "mov %%ax, %%es\n\t"
+                     "mov %%ax, %%fs\n\t"
+                     "mov %%ax, %%gs\n\t"
+                     "mov %%ax, %%ss\n\t"
+                     "mov %3, %%ax\n\t"
+                     "ltr %%ax"
+                     :
+                     : "m"(gdt_desc), "i"(GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA), "i"(GDT_TSS)
+                     : "eax", "memory");
+}
+
+void gdt_set_kernel_stack(uint32_t esp0)
+{
+    tss.esp0 = esp0;
+}
+
+/* Point the per-CPU descriptor at this CPU's area and load it into %gs */
+void gdt_set_percpu(void *base, uint32_t size)
+{
+    set_entry(GDT_PERCPU / 8, (uint32_t)base, size - 1, 0x92, 0x40); /* byte granular */
+    __asm__ volatile("mov %0, %%gs" : : "r"((uint16_t)GDT_PERCPU) : "memory");
+}
+
+/* SYSENTER loads ESP from an MSR; pointing it here lets the entry stub
+   fetch the current process's kernel stack with a single load */
+uint32_t *gdt_kernel_stack_slot(void)
+{
+    return &tss.esp0;
+}
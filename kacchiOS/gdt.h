@@ -0,0 +1,41 @@
+/* gdt.h - Global descriptor table and task state segment */
+#ifndef GDT_H
+#define GDT_H
+
+#include "types.h"
+
+/* Selector layout is fixed by SYSENTER/SYSEXIT: user CS/SS follow kernel CS */
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_USER_CODE 0x18
+#define GDT_USER_DATA 0x20
+#define GDT_TSS 0x28
+#define GDT_PERCPU 0x30 /* kernel %gs: base is this CPU's percpu_t */
+
+#define GDT_RPL_USER 0x3
+
+typedef struct tss
+{
+    uint32_t prev_task;
+    uint32_t esp0; /* kernel stack loaded on entry from ring 3 */
+    uint32_t ss0;
+    uint32_t esp1;
+    uint32_t ss1;
+    uint32_t esp2;
+    uint32_t ss2;
+    uint32_t cr3;
+    uint32_t eip;
+    uint32_t eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} tss_t;
+
+void gdt_init(void);
+void gdt_set_kernel_stack(uint32_t esp0);
+uint32_t *gdt_kernel_stack_slot(void);
+void gdt_set_percpu(void *base, uint32_t size);
+
+#endif
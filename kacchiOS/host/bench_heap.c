@@ -0,0 +1,128 @@
+/* bench_heap.c - Host benchmark of heap_alloc/heap_free hot paths and
+ * of per-process arenas
+ *
+ * usage: bench_heap [iterations]   (default 5000000 per workload)
+ */
+#include <stdlib.h>
+#include "host.h"
+#include "memory.h"
+#include "arena.h"
+
+#define LIFO_SLOTS 32
+#define RANDOM_SLOTS 256
+#define WORKER_ALLOCS 32
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1103515245u + 12345u;
+    return rng_state >> 8;
+}
+
+/* Back-to-back alloc/free of one size: best case for first fit */
+static void bench_fixed(uint64_t iterations)
+{
+    memory_init();
+    uint64_t start = host_now_ns();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        void *p = heap_alloc(64);
+        heap_free(p);
+    }
+    host_report("host_heap_fixed64", iterations * 2, host_now_ns() - start);
+}
+
+/* The kernel's heap_alloc_mixed pattern: fill a window, free it LIFO */
+static void bench_lifo_mixed(uint64_t iterations)
+{
+    void *slots[LIFO_SLOTS];
+    uint64_t ops = 0;
+    memory_init();
+    uint64_t start = host_now_ns();
+    while (ops < iterations)
+    {
+        for (int i = 0; i < LIFO_SLOTS; i++)
+        {
+            slots[i] = heap_alloc(16 + rng_next() % 1009);
+        }
+        for (int i = LIFO_SLOTS - 1; i >= 0; i--)
+        {
+            heap_free(slots[i]);
+        }
+        ops += LIFO_SLOTS;
+    }
+    host_report("host_heap_lifo_mixed", ops * 2, host_now_ns() - start);
+}
+
+/* Long-lived random set: frees land anywhere, so the free list fragments */
+static void bench_random_churn(uint64_t iterations)
+{
+    void *slots[RANDOM_SLOTS] = {0};
+    uint64_t failures = 0;
+    memory_init();
+    uint64_t start = host_now_ns();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        uint32_t s = rng_next() % RANDOM_SLOTS;
+        if (slots[s])
+        {
+            heap_free(slots[s]);
+            slots[s] = 0;
+        }
+        else if (!(slots[s] = heap_alloc(16 + rng_next() % 2033)))
+        {
+            failures++;
+        }
+    }
+    uint64_t ns = host_now_ns() - start;
+    host_report("host_heap_random_churn", iterations, ns);
+
+    uint32_t total_free, largest;
+    memory_get_stats(&total_free, &largest);
+    printf("  free=%u largest=%u failures=%llu\n", total_free, largest,
+           (unsigned long long)failures);
+    for (int s = 0; s < RANDOM_SLOTS; s++)
+    {
+        heap_free(slots[s]);
+    }
+}
+
+/* A short-lived worker's allocations: the lifo_mixed window from an
+ * arena, dropped in one release instead of freed one by one */
+static void bench_arena_worker(uint64_t iterations)
+{
+    arena_t arena;
+    uint64_t ops = 0;
+    uint64_t failures = 0;
+    memory_init();
+    arena_cache_init();
+    arena_init(&arena, 0);
+    uint64_t start = host_now_ns();
+    while (ops < iterations)
+    {
+        for (int i = 0; i < WORKER_ALLOCS; i++)
+        {
+            if (!arena_alloc(&arena, 16 + rng_next() % 1009))
+                failures++;
+        }
+        arena_release(&arena);
+        ops += WORKER_ALLOCS;
+    }
+    host_report("host_arena_worker", ops, host_now_ns() - start);
+
+    arena_stats_t st;
+    arena_get_stats(&st);
+    printf("  heap_chunks=%u reuses=%u failures=%llu\n", st.heap_chunks, st.reuses,
+           (unsigned long long)failures);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t iterations = argc > 1 ? strtoull(argv[1], 0, 10) : 5000000;
+    bench_fixed(iterations);
+    bench_lifo_mixed(iterations);
+    bench_random_churn(iterations);
+    bench_arena_worker(iterations);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/* bench_ipc.c - Host benchmark of IPC and yield through the real scheduler
+ *
+ * Kernel processes run on heap stacks switched by context_x86_64.S;
+ * scheduler_start() returns to main once every process has exited.
+ * usage: bench_ipc [messages]   (default 2000000)
+ */
+#include <stdlib.h>
+#include "host.h"
+#include "ipc.h"
+#include "memory.h"
+#include "process.h"
+#include "scheduler.h"
+
+#define BENCH_STACK (16 * 1024)
+#define IPC_STOP 0xFFFFFFFE /* ~0 cannot survive the direct handoff */
+
+static ipc_queue_t queue;
+static ipc_queue_t reply;
+static uint64_t messages;
+static uint64_t received;
+
+static void producer(void *arg)
+{
+    (void)arg;
+    for (uint64_t i = 0; i < messages; i++)
+    {
+        ipc_send(&queue, (uint32_t)(i & 0x7FFFFFFF));
+    }
+    ipc_send(&queue, IPC_STOP);
+}
+
+static void consumer(void *arg)
+{
+    (void)arg;
+    uint32_t v;
+    while (ipc_recv(&queue, &v) == 0 && v != IPC_STOP)
+    {
+        received++;
+    }
+}
+
+static void pinger(void *arg)
+{
+    (void)arg;
+    uint32_t v;
+    for (uint64_t i = 0; i < messages; i++)
+    {
+        ipc_send(&queue, 1);
+        ipc_recv(&reply, &v);
+    }
+    ipc_send(&queue, IPC_STOP);
+}
+
+static void ponger(void *arg)
+{
+    (void)arg;
+    uint32_t v;
+    while (ipc_recv(&queue, &v) == 0 && v != IPC_STOP)
+    {
+        ipc_send(&reply, v);
+    }
+}
+
+static void yielder(void *arg)
+{
+    (void)arg;
+    for (uint64_t i = 0; i < messages; i++)
+    {
+        scheduler_yield();
+    }
+}
+
+static void reset(void)
+{
+    memory_init();
+    process_init();
+    scheduler_init();
+    ipc_init(&queue);
+    ipc_init(&reply);
+    received = 0;
+}
+
+int main(int argc, char **argv)
+{
+    messages = argc > 1 ? strtoull(argv[1], 0, 10) : 2000000;
+
+    reset();
+    process_create(consumer, 0, BENCH_STACK);
+    process_create(producer, 0, BENCH_STACK);
+    uint64_t start = host_now_ns();
+    scheduler_start();
+    host_report("host_ipc_stream", messages, host_now_ns() - start);
+    if (received != messages)
+    {
+        fprintf(stderr, "ipc_stream: received %llu of %llu\n", (unsigned long long)received,
+                (unsigned long long)messages);
+        return 1;
+    }
+
+    reset();
+    process_create(ponger, 0, BENCH_STACK);
+    process_create(pinger, 0, BENCH_STACK);
+    start = host_now_ns();
+    scheduler_start();
+    host_report("host_ipc_pingpong", messages, host_now_ns() - start);
+
+    reset();
+    process_create(yielder, 0, BENCH_STACK);
+    process_create(yielder, 0, BENCH_STACK);
+    start = host_now_ns();
+    scheduler_start();
+    host_report("host_yield_ready2", messages * 2, host_now_ns() - start);
+    return 0;
+}
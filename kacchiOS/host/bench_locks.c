@@ -0,0 +1,150 @@
+/* bench_locks.c - Host benchmark of the kernel locks under real contention
+ *
+ * spinlock.c is built with LOCK_SMP=1 here, so the ticket, MCS and
+ * reader-writer paths run on as many pthreads as asked for. Each thread
+ * takes the lock, updates a shared counter and lets go. Kernel holders
+ * run with interrupts off and are never preempted, but a thread can be,
+ * and then every waiter spins out its time slice; so thread counts stop
+ * at the number of online CPUs.
+ * usage: bench_locks [threads] [iterations per thread]   (default 4, 1000000)
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "host.h"
+#include "spinlock.h"
+
+#define READS_PER_WRITE 15
+
+static spinlock_t ticket;
+static mcs_lock_t mcs;
+static rwlock_t rw;
+static uint64_t iterations;
+static volatile uint64_t shared_counter;
+static volatile int go;
+
+static void wait_for_go(void)
+{
+    while (!go)
+        ;
+}
+
+static void *ticket_worker(void *arg)
+{
+    (void)arg;
+    wait_for_go();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        uint32_t flags = spin_lock_irqsave(&ticket);
+        shared_counter++;
+        spin_unlock_irqrestore(&ticket, flags);
+    }
+    return 0;
+}
+
+static void *mcs_worker(void *arg)
+{
+    (void)arg;
+    mcs_node_t node;
+    wait_for_go();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        uint32_t flags = mcs_lock_irqsave(&mcs, &node);
+        shared_counter++;
+        mcs_unlock_irqrestore(&mcs, &node, flags);
+    }
+    return 0;
+}
+
+/* Mostly readers, as on the process table */
+static void *rw_worker(void *arg)
+{
+    (void)arg;
+    uint64_t sum = 0;
+    wait_for_go();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        if (i % (READS_PER_WRITE + 1) == 0)
+        {
+            uint32_t flags = write_lock_irqsave(&rw);
+            shared_counter++;
+            write_unlock_irqrestore(&rw, flags);
+        }
+        else
+        {
+            uint32_t flags = read_lock_irqsave(&rw);
+            sum += shared_counter;
+            read_unlock_irqrestore(&rw, flags);
+        }
+    }
+    return (void *)(uintptr_t)sum;
+}
+
+static int run(const char *name, void *(*worker)(void *), int threads)
+{
+    pthread_t tids[64];
+    shared_counter = 0;
+    go = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_create(&tids[i], 0, worker, 0);
+    }
+    uint64_t start = host_now_ns();
+    go = 1;
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tids[i], 0);
+    }
+    uint64_t ns = host_now_ns() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s_t%d", name, threads);
+    host_report(label, iterations * (uint64_t)threads, ns);
+
+    uint64_t expect = worker == rw_worker
+                          ? (iterations + READS_PER_WRITE) / (READS_PER_WRITE + 1) * threads
+                          : iterations * (uint64_t)threads;
+    if (shared_counter != expect)
+    {
+        fprintf(stderr, "%s: counter %llu, expected %llu\n", label,
+                (unsigned long long)shared_counter, (unsigned long long)expect);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : 4;
+    iterations = argc > 2 ? strtoull(argv[2], 0, 10) : 1000000;
+    if (max_threads < 1 || max_threads > 64)
+    {
+        fprintf(stderr, "threads must be 1-64\n");
+        return 1;
+    }
+
+    spin_lock_init(&ticket, "ticket");
+    mcs_lock_init(&mcs, "mcs");
+    rwlock_init(&rw, "rw");
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0 && max_threads > cpus)
+    {
+        printf("capping threads at %ld online CPUs\n", cpus);
+        max_threads = (int)cpus;
+    }
+
+    int failed = 0;
+    for (int t = 1; t <= max_threads; t *= 2)
+    {
+        failed |= run("host_lock_ticket", ticket_worker, t);
+        failed |= run("host_lock_mcs", mcs_worker, t);
+        failed |= run("host_lock_rw", rw_worker, t);
+    }
+
+    for (const lock_stats_t *s = lock_stats_first(); s; s = s->next)
+    {
+        printf("LOCK %s acquisitions=%u contended=%u spin_cycles=%llu\n", s->name,
+               s->acquisitions, s->contended, (unsigned long long)s->spin_cycles);
+    }
+    return failed;
+}
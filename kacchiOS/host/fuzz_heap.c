@@ -0,0 +1,96 @@
+/* fuzz_heap.c - libFuzzer harness for heap_alloc/heap_free sequences
+ *
+ * Each input is a little program over 64 slots, three bytes per step:
+ *   op & 1 == 0: allocate ((b1 | b2 << 8) % MAX_REQUEST) + 1 bytes into slot op >> 2
+ *   op & 1 == 1: free slot op >> 2
+ * Live blocks are filled with their slot tag and checked when freed, so
+ * overlapping blocks or a clobbered header show up as a mismatch. After
+ * the sequence everything is freed and the heap must coalesce back to a
+ * single block of the starting size.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+
+#define SLOTS 64
+#define MAX_REQUEST 32768
+#define ALIGNMENT 16
+
+typedef struct
+{
+    uint8_t *ptr;
+    size_t size;
+} slot_t;
+
+static void fail(const char *what, size_t detail)
+{
+    fprintf(stderr, "fuzz_heap: %s (%zu)\n", what, detail);
+    abort();
+}
+
+static void check_and_free(slot_t *s, uint8_t tag)
+{
+    for (size_t i = 0; i < s->size; i++)
+    {
+        if (s->ptr[i] != tag)
+            fail("live block contents changed", i);
+    }
+    heap_free(s->ptr);
+    s->ptr = 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t len)
+{
+    slot_t slots[SLOTS];
+    uint32_t initial_free, initial_largest;
+
+    memset(slots, 0, sizeof(slots));
+    memory_init();
+    memory_get_stats(&initial_free, &initial_largest);
+
+    for (size_t i = 0; i + 3 <= len; i += 3)
+    {
+        uint8_t op = data[i];
+        uint8_t idx = (op >> 2) % SLOTS;
+        slot_t *s = &slots[idx];
+
+        if (op & 1)
+        {
+            if (s->ptr)
+                check_and_free(s, idx);
+            continue;
+        }
+        if (s->ptr)
+            continue;
+
+        size_t size = ((size_t)(data[i + 1] | data[i + 2] << 8) % MAX_REQUEST) + 1;
+        uint32_t largest;
+        memory_get_stats(0, &largest);
+        s->ptr = (uint8_t *)heap_alloc(size);
+        if (!s->ptr)
+        {
+            /* First fit must succeed whenever some free block is big enough */
+            if (largest >= (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)
+                fail("allocation failed with a large enough free block", size);
+            continue;
+        }
+        if ((uintptr_t)s->ptr % ALIGNMENT)
+            fail("misaligned block", (uintptr_t)s->ptr);
+        s->size = size;
+        memset(s->ptr, idx, size);
+    }
+
+    for (int i = 0; i < SLOTS; i++)
+    {
+        if (slots[i].ptr)
+            check_and_free(&slots[i], (uint8_t)i);
+    }
+
+    uint32_t total_free, largest;
+    memory_get_stats(&total_free, &largest);
+    if (total_free != initial_free || largest != initial_largest)
+        fail("heap did not coalesce back to its initial state", total_free);
+    return 0;
+}
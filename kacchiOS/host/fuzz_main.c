@@ -0,0 +1,58 @@
+/* fuzz_main.c - Run the fuzz harness without libFuzzer
+ *
+ * usage: fuzz_heap_replay [file...]
+ * Replays each file (e.g. a crash or corpus entry from 'make host-fuzz');
+ * with no files it runs a fixed number of pseudo-random inputs instead.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RANDOM_RUNS 2000
+#define MAX_INPUT 3072
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t len);
+
+static int replay(const char *path)
+{
+    static uint8_t buf[1 << 20];
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    LLVMFuzzerTestOneInput(buf, len);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (replay(argv[i]) < 0)
+                return 1;
+        }
+        printf("replayed %d inputs\n", argc - 1);
+        return 0;
+    }
+
+    static uint8_t buf[MAX_INPUT];
+    uint32_t state = 1;
+    for (int run = 0; run < RANDOM_RUNS; run++)
+    {
+        size_t len = (size_t)(run % MAX_INPUT);
+        for (size_t i = 0; i < len; i++)
+        {
+            state = state * 1103515245u + 12345u;
+            buf[i] = (uint8_t)(state >> 16);
+        }
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+    printf("ran %d random inputs\n", RANDOM_RUNS);
+    return 0;
+}
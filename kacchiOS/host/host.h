@@ -0,0 +1,24 @@
+/* host.h - Shared helpers for the hosted benchmark and fuzz drivers */
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static inline uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Same shape as the kernel's BENCH lines so results can be compared */
+static inline void host_report(const char *name, uint64_t ops, uint64_t ns)
+{
+    printf("BENCH %s ops=%llu ns_per_op=%.2f mops_per_s=%.2f\n", name,
+           (unsigned long long)ops, ops ? (double)ns / (double)ops : 0.0,
+           ns ? (double)ops * 1000.0 / (double)ns : 0.0);
+}
+
+#endif
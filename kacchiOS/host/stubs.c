@@ -0,0 +1,70 @@
+/* stubs.c - Hardware hooks the hosted modules link against */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "cpu.h"
+#include "gdt.h"
+#include "paging.h"
+#include "serial.h"
+#include "syscall.h"
+#include "tsc.h"
+
+void gdt_set_kernel_stack(uint32_t esp0)
+{
+    (void)esp0;
+}
+
+int syscall_available(void)
+{
+    return 0; /* no ring 3 on the host; process_create_user fails cleanly */
+}
+
+void user_mode_enter(uint32_t eip, uint32_t esp)
+{
+    (void)eip;
+    (void)esp;
+    fprintf(stderr, "user_mode_enter: not available in the hosted build\n");
+    abort();
+}
+
+void cpu_halt(void)
+{
+    abort();
+}
+
+/* No paging on the host: processes never get private memory to share */
+int vm_clone(process_t *parent, process_t *child)
+{
+    (void)parent;
+    (void)child;
+    return 0;
+}
+
+void vm_release(process_t *proc)
+{
+    (void)proc;
+}
+
+void serial_puts(const char *str)
+{
+    fputs(str, stdout);
+}
+
+void serial_flush(void)
+{
+    fflush(stdout);
+}
+
+/* The PIT is not reachable from user space: time the TSC against the clock */
+uint64_t tsc_us_to_cycles(uint32_t us)
+{
+    static uint64_t cycles_per_ms = 0;
+    if (!cycles_per_ms)
+    {
+        struct timespec ts = {0, 10 * 1000 * 1000};
+        uint64_t start = rdtsc();
+        nanosleep(&ts, 0);
+        cycles_per_ms = (rdtsc() - start) / 10;
+    }
+    return (uint64_t)us * cycles_per_ms / 1000;
+}
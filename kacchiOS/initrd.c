@@ -0,0 +1,268 @@
+/* initrd.c - Index ustar archives (and raw modules) passed with -initrd */
+#include "initrd.h"
+#include "multiboot.h"
+#include "string.h"
+
+#define INITRD_HASH_SIZE 64
+#define TAR_BLOCK 512
+
+typedef struct tar_header
+{
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char chksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6]; /* "ustar\0" */
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+} tar_header_t;
+
+typedef struct initrd_file
+{
+    const char *name; /* points into the module, not NUL-terminated */
+    uint32_t name_len;
+    const uint8_t *data;
+    uint32_t size;
+    int next; /* hash chain, -1 terminates */
+} initrd_file_t;
+
+static initrd_file_t files[INITRD_MAX_FILES];
+static int buckets[INITRD_HASH_SIZE];
+static int file_count = 0;
+
+/* FNV-1a over exactly len bytes */
+static uint32_t hash_name(const char *name, uint32_t len)
+{
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* -1 if the field holds more than 32 bits (11 digits can hold 33) */
+static int parse_octal(const char *field, int width, uint32_t *out)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < width && field[i] >= '0' && field[i] <= '7'; i++)
+    {
+        if (value > 0xFFFFFFFFu >> 3)
+        {
+            return -1;
+        }
+        value = (value << 3) | (uint32_t)(field[i] - '0');
+    }
+    *out = value;
+    return 0;
+}
+
+static void add_file(const char *name, uint32_t name_len, const uint8_t *data, uint32_t size)
+{
+    if (file_count == INITRD_MAX_FILES || !name_len)
+    {
+        return;
+    }
+    initrd_file_t *f = &files[file_count];
+    f->name = name;
+    f->name_len = name_len;
+    f->data = data;
+    f->size = size;
+
+    uint32_t b = hash_name(name, name_len) % INITRD_HASH_SIZE;
+    f->next = buckets[b];
+    buckets[b] = file_count;
+    file_count++;
+}
+
+static int is_ustar(const uint8_t *start, const uint8_t *end)
+{
+    if (end - start < TAR_BLOCK)
+    {
+        return 0;
+    }
+    const tar_header_t *h = (const tar_header_t *)start;
+    return h->magic[0] == 'u' && h->magic[1] == 's' && h->magic[2] == 't' &&
+           h->magic[3] == 'a' && h->magic[4] == 'r';
+}
+
+static void index_tar(const uint8_t *start, const uint8_t *end)
+{
+    const uint8_t *p = start;
+    while (end - p >= TAR_BLOCK)
+    {
+        const tar_header_t *h = (const tar_header_t *)p;
+        if (!h->name[0]) /* two zero blocks end the archive */
+        {
+            break;
+        }
+
+        uint32_t size;
+        const uint8_t *data = p + TAR_BLOCK;
+        if (parse_octal(h->size, sizeof(h->size), &size) < 0 || size > (uint32_t)(end - data))
+        {
+            break;
+        }
+
+        if (h->typeflag == '0' || h->typeflag == '\0')
+        {
+            const char *name = h->name;
+            uint32_t len = 0;
+            while (len < sizeof(h->name) && name[len])
+                len++;
+            while (len >= 2 && name[0] == '.' && name[1] == '/')
+            {
+                name += 2;
+                len -= 2;
+            }
+            add_file(name, len, data, size);
+        }
+        /* size fits the module, so rounding it up cannot wrap */
+        uint32_t padded = ((size + TAR_BLOCK - 1) / TAR_BLOCK) * TAR_BLOCK;
+        if (padded > (uint32_t)(end - data))
+        {
+            break; /* archive cut short after this file */
+        }
+        p = data + padded;
+    }
+}
+
+/* A module that is not an archive is one file named after its command line */
+static void index_raw(const multiboot_module_t *mod)
+{
+    const char *cmd = (const char *)mod->string;
+    const char *name = cmd ? cmd : "";
+    uint32_t len = 0;
+
+    for (const char *c = name; *c && *c != ' '; c++)
+    {
+        if (*c == '/')
+        {
+            name = c + 1;
+        }
+    }
+    while (name[len] && name[len] != ' ')
+        len++;
+    add_file(name, len, (const uint8_t *)mod->mod_start, mod->mod_end - mod->mod_start);
+}
+
+int initrd_init(void)
+{
+    file_count = 0;
+    for (int i = 0; i < INITRD_HASH_SIZE; i++)
+    {
+        buckets[i] = -1;
+    }
+
+    for (int i = 0; i < multiboot_module_count(); i++)
+    {
+        const multiboot_module_t *mod = multiboot_get_module(i);
+        const uint8_t *start = (const uint8_t *)mod->mod_start;
+        const uint8_t *end = (const uint8_t *)mod->mod_end;
+        if (is_ustar(start, end))
+        {
+            index_tar(start, end);
+        }
+        else
+        {
+            index_raw(mod);
+        }
+    }
+    return file_count;
+}
+
+int initrd_count(void)
+{
+    return file_count;
+}
+
+int initrd_open(const char *name)
+{
+    if (!name)
+    {
+        return -1;
+    }
+    uint32_t len = 0;
+    while (name[len])
+        len++;
+
+    int idx = buckets[hash_name(name, len) % INITRD_HASH_SIZE];
+    while (idx >= 0)
+    {
+        const initrd_file_t *f = &files[idx];
+        if (f->name_len == len)
+        {
+            uint32_t i = 0;
+            while (i < len && f->name[i] == name[i])
+                i++;
+            if (i == len)
+            {
+                return idx;
+            }
+        }
+        idx = f->next;
+    }
+    return -1;
+}
+
+uint32_t initrd_size(int fd)
+{
+    if (fd < 0 || fd >= file_count)
+    {
+        return 0;
+    }
+    return files[fd].size;
+}
+
+const char *initrd_name(int fd, uint32_t *len)
+{
+    if (fd < 0 || fd >= file_count)
+    {
+        return 0;
+    }
+    if (len)
+        *len = files[fd].name_len;
+    return files[fd].name;
+}
+
+int initrd_read(int fd, uint32_t offset, void *buf, uint32_t len)
+{
+    if (fd < 0 || fd >= file_count || !buf)
+    {
+        return -1;
+    }
+    const initrd_file_t *f = &files[fd];
+    if (offset >= f->size)
+    {
+        return 0;
+    }
+    if (len > f->size - offset)
+    {
+        len = f->size - offset;
+    }
+
+    memcpy(buf, f->data + offset, len);
+    return (int)len;
+}
+
+const void *initrd_map(int fd, uint32_t *size)
+{
+    if (fd < 0 || fd >= file_count)
+    {
+        return 0;
+    }
+    if (size)
+        *size = files[fd].size;
+    return files[fd].data;
+}
@@ -0,0 +1,21 @@
+/* initrd.h - Read-only RAM filesystem built from multiboot modules */
+#ifndef INITRD_H
+#define INITRD_H
+
+#include "types.h"
+
+#define INITRD_MAX_FILES 64
+
+int initrd_init(void);
+int initrd_count(void);
+
+/* Handles are small integers valid for the lifetime of the kernel */
+int initrd_open(const char *name);
+uint32_t initrd_size(int fd);
+const char *initrd_name(int fd, uint32_t *len);
+int initrd_read(int fd, uint32_t offset, void *buf, uint32_t len);
+
+/* Zero-copy access: pointer straight into the boot module */
+const void *initrd_map(int fd, uint32_t *size);
+
+#endif
@@ -14,4 +14,39 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
-#endif
\ No newline at end of file
+static inline void outw(uint16_t port, uint16_t val) {
+    __asm__ volatile ("outw %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t ret;
+    __asm__ volatile ("inw %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outl(uint16_t port, uint32_t val) {
+    __asm__ volatile ("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    __asm__ volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+/* Move count 16-bit words between a port and memory (ATA PIO data) */
+static inline void insw(uint16_t port, void *buf, uint32_t count) {
+    __asm__ volatile ("cld; rep insw"
+                      : "+D"(buf), "+c"(count)
+                      : "d"(port)
+                      : "memory");
+}
+
+static inline void outsw(uint16_t port, const void *buf, uint32_t count) {
+    __asm__ volatile ("cld; rep outsw"
+                      : "+S"(buf), "+c"(count)
+                      : "d"(port)
+                      : "memory");
+}
+
+#endif
@@ -36,10 +36,11 @@ int ipc_send(ipc_queue_t *q, uint32_t value)
     {
         return -1;
     }
+    percpu_inc(ipc_sends);
 
     while (q->count == IPC_QUEUE_CAP)
     {
-        enqueue_waiter(&q->waiting_senders, scheduler_current());
+        enqueue_waiter(&q->waiting_senders, process_current());
         process_block_current();
     }
 
@@ -48,7 +49,7 @@ int ipc_send(ipc_queue_t *q, uint32_t value)
     if (recv)
     {
         /* Store value in arg; use (value+1) to distinguish 0 from NULL */
-        recv->arg = (void *)(uint32_t)(value + 1);
+        recv->arg = (void *)(uintptr_t)(value + 1);
         scheduler_unblock(recv);
         return 0;
     }
@@ -60,31 +61,39 @@ int ipc_send(ipc_queue_t *q, uint32_t value)
     return 0;
 }
 
+/* Dequeue the oldest buffered message; the caller wakes a blocked sender */
+static void take_message(ipc_queue_t *q, uint32_t *out_value)
+{
+    *out_value = q->buf[q->head];
+    q->head = (q->head + 1) % IPC_QUEUE_CAP;
+    q->count--;
+}
+
 int ipc_recv(ipc_queue_t *q, uint32_t *out_value)
 {
     if (!q || !out_value)
     {
         return -1;
     }
+    percpu_inc(ipc_recvs);
 
     while (1)
     {
         if (q->count > 0)
         {
-            *out_value = q->buf[q->head];
-            q->head = (q->head + 1) % IPC_QUEUE_CAP;
-            q->count--;
+            take_message(q, out_value);
             break;
         }
 
-        enqueue_waiter(&q->waiting_receivers, scheduler_current());
+        enqueue_waiter(&q->waiting_receivers, process_current());
         process_block_current();
 
         /* If we were unblocked via direct handoff, arg has (value+1) stored */
-        if (scheduler_current()->arg)
+        process_t *self = process_current();
+        if (self->arg)
         {
-            *out_value = (uint32_t)scheduler_current()->arg - 1;
-            scheduler_current()->arg = 0;
+            *out_value = (uint32_t)(uintptr_t)self->arg - 1;
+            self->arg = 0;
             break;
         }
     }
@@ -97,3 +106,20 @@ int ipc_recv(ipc_queue_t *q, uint32_t *out_value)
     }
     return 0;
 }
+
+int ipc_try_recv(ipc_queue_t *q, uint32_t *out_value)
+{
+    if (!q || !out_value || q->count == 0)
+    {
+        return -1;
+    }
+    percpu_inc(ipc_recvs);
+    take_message(q, out_value);
+
+    process_t *sender = dequeue_waiter(&q->waiting_senders);
+    if (sender)
+    {
+        scheduler_unblock(sender);
+    }
+    return 0;
+}
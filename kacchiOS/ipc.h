@@ -20,5 +20,7 @@ typedef struct ipc_queue
 void ipc_init(ipc_queue_t *q);
 int ipc_send(ipc_queue_t *q, uint32_t value);
 int ipc_recv(ipc_queue_t *q, uint32_t *out_value);
+/* Non-blocking receive: -1 if the queue is empty */
+int ipc_try_recv(ipc_queue_t *q, uint32_t *out_value);
 
 #endif
@@ -0,0 +1,218 @@
+/* irq.c - Interrupt descriptor table, 8259 PIC setup and dispatch
+ *
+ * All 48 vectors use interrupt gates, so handlers start with interrupts
+ * off. Copy-on-write page faults are resolved by paging.c; other
+ * exceptions from ring 3 end the offending process, and exceptions in
+ * the kernel print the frame and halt. PIC lines are masked until a
+ * handler is registered for them.
+ */
+#include "irq.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "paging.h"
+#include "io.h"
+#include "percpu.h"
+#include "process.h"
+#include "serial.h"
+
+#define IDT_ENTRIES 48
+#define VECTOR_PAGE_FAULT 14
+#define IDT_INTERRUPT_GATE 0x8E /* present, DPL 0, 32-bit interrupt gate */
+
+#define PIC1_CMD 0x20
+#define PIC1_DATA 0x21
+#define PIC2_CMD 0xA0
+#define PIC2_DATA 0xA1
+#define PIC_EOI 0x20
+#define PIC_READ_ISR 0x0B
+#define PIC_CASCADE_LINE 2
+
+typedef struct idt_entry
+{
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct idt_ptr
+{
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_ptr_t;
+
+extern const uint32_t isr_stub_table[IDT_ENTRIES];
+
+static idt_entry_t idt[IDT_ENTRIES];
+static idt_ptr_t idt_desc;
+static irq_handler_t handlers[IRQ_LINES];
+static irq_line_stats_t line_stats[IRQ_LINES];
+static uint32_t spurious = 0;
+
+static const char *exception_names[] = {
+    "divide error", "debug", "NMI", "breakpoint", "overflow", "bound range",
+    "invalid opcode", "device not available", "double fault", "coprocessor overrun",
+    "invalid TSS", "segment not present", "stack fault", "general protection",
+    "page fault", "reserved", "x87 error", "alignment check", "machine check",
+    "SIMD error"};
+
+static void pic_remap(void)
+{
+    outb(PIC1_CMD, 0x11); /* ICW1: init, expect ICW4 */
+    outb(PIC2_CMD, 0x11);
+    outb(PIC1_DATA, IRQ_BASE_VECTOR);     /* ICW2: vector offsets */
+    outb(PIC2_DATA, IRQ_BASE_VECTOR + 8);
+    outb(PIC1_DATA, 1 << PIC_CASCADE_LINE); /* ICW3: slave on line 2 */
+    outb(PIC2_DATA, PIC_CASCADE_LINE);
+    outb(PIC1_DATA, 0x01); /* ICW4: 8086 mode */
+    outb(PIC2_DATA, 0x01);
+
+    /* Everything masked except the cascade until handlers register */
+    outb(PIC1_DATA, (uint8_t)~(1 << PIC_CASCADE_LINE));
+    outb(PIC2_DATA, 0xFF);
+}
+
+static void pic_unmask(uint32_t line)
+{
+    uint16_t port = line < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) & ~(1 << (line & 7)));
+}
+
+static void pic_eoi(uint32_t line)
+{
+    if (line >= 8)
+    {
+        outb(PIC2_CMD, PIC_EOI);
+    }
+    outb(PIC1_CMD, PIC_EOI);
+}
+
+/* Lines 7 and 15 also fire spuriously; the in-service bit tells them apart */
+static int pic_spurious(uint32_t line)
+{
+    if ((line & 7) != 7)
+    {
+        return 0;
+    }
+    uint16_t cmd = line < 8 ? PIC1_CMD : PIC2_CMD;
+    outb(cmd, PIC_READ_ISR);
+    if (inb(cmd) & 0x80)
+    {
+        return 0;
+    }
+    if (line == 15)
+    {
+        outb(PIC1_CMD, PIC_EOI); /* the master did see the cascade */
+    }
+    return 1;
+}
+
+void irq_init(void)
+{
+    for (int i = 0; i < IDT_ENTRIES; i++)
+    {
+        uint32_t addr = isr_stub_table[i];
+        idt[i].offset_low = addr & 0xFFFF;
+        idt[i].selector = GDT_KERNEL_CODE;
+        idt[i].zero = 0;
+        idt[i].type_attr = IDT_INTERRUPT_GATE;
+        idt[i].offset_high = (addr >> 16) & 0xFFFF;
+    }
+    idt_desc.limit = sizeof(idt) - 1;
+    idt_desc.base = (uint32_t)idt;
+    __asm__ volatile("lidt %0" : : "m"(idt_desc));
+
+    pic_remap();
+}
+
+int irq_register(uint32_t line, irq_handler_t handler)
+{
+    if (line >= IRQ_LINES || !handler || handlers[line])
+    {
+        return -1;
+    }
+    uint32_t flags = irq_save();
+    handlers[line] = handler;
+    pic_unmask(line);
+    irq_restore(flags);
+    return 0;
+}
+
+void irq_get_stats(uint32_t line, irq_line_stats_t *out)
+{
+    if (line < IRQ_LINES && out)
+    {
+        *out = line_stats[line];
+    }
+}
+
+uint32_t irq_spurious_count(void)
+{
+    return spurious;
+}
+
+static void exception(irq_frame_t *frame)
+{
+    int from_user = (frame->cs & 3) == GDT_RPL_USER;
+    process_t *proc = process_current();
+
+    serial_puts("\n*** ");
+    serial_puts(frame->vector < sizeof(exception_names) / sizeof(exception_names[0])
+                    ? exception_names[frame->vector]
+                    : "exception");
+    serial_puts(" (vector ");
+    serial_putu(frame->vector);
+    serial_puts(", error ");
+    serial_putu(frame->error);
+    serial_puts(") at eip ");
+    serial_putu(frame->eip);
+    serial_puts(from_user ? " in ring 3, pid " : " in kernel, pid ");
+    serial_putu(proc ? (uint32_t)proc->pid : 0);
+    serial_puts("\n");
+
+    if (from_user && proc)
+    {
+        /* The frame is abandoned with the process's stack */
+        irq_enable();
+        process_exit();
+    }
+    serial_flush();
+    cpu_halt();
+}
+
+void interrupt_dispatch(irq_frame_t *frame)
+{
+    if (frame->vector == VECTOR_PAGE_FAULT && vm_handle_fault(read_cr2(), frame->error) == 0)
+    {
+        return; /* copy-on-write resolved; retry the write */
+    }
+    if (frame->vector < IRQ_BASE_VECTOR)
+    {
+        exception(frame);
+        return;
+    }
+
+    uint32_t line = frame->vector - IRQ_BASE_VECTOR;
+    if (pic_spurious(line))
+    {
+        spurious++;
+        return;
+    }
+
+    uint64_t start = rdtsc();
+    percpu_inc(irqs);
+    if (handlers[line])
+    {
+        handlers[line]();
+    }
+    pic_eoi(line);
+
+    irq_line_stats_t *st = &line_stats[line];
+    uint64_t cycles = rdtsc() - start;
+    st->count++;
+    if (cycles > st->max_cycles)
+    {
+        st->max_cycles = cycles > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)cycles;
+    }
+}
@@ -0,0 +1,46 @@
+/* irq.h - IDT, 8259 PIC and interrupt dispatch */
+#ifndef IRQ_H
+#define IRQ_H
+
+#include "types.h"
+
+#define IRQ_BASE_VECTOR 32 /* PIC lines 0-15 are remapped to vectors 32-47 */
+#define IRQ_LINES 16
+
+#define IRQ_TIMER 0
+#define IRQ_COM1 4
+
+/* Stack layout built by isr.S, lowest address first */
+typedef struct irq_frame
+{
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebp, esp_unused, ebx, edx, ecx, eax;
+    uint32_t vector;
+    uint32_t error;
+    uint32_t eip, cs, eflags;
+    uint32_t user_esp, user_ss; /* only present when interrupted in ring 3 */
+} irq_frame_t;
+
+/* Top halves run with interrupts off and must only touch their own
+ * device state and queue deferred work (defer.h) */
+typedef void (*irq_handler_t)(void);
+
+typedef struct irq_line_stats
+{
+    uint32_t count;
+    uint32_t max_cycles; /* longest top half, including the EOI */
+} irq_line_stats_t;
+
+void irq_init(void);
+int irq_register(uint32_t line, irq_handler_t handler);
+void irq_get_stats(uint32_t line, irq_line_stats_t *out);
+uint32_t irq_spurious_count(void);
+
+void interrupt_dispatch(irq_frame_t *frame);
+
+static inline void irq_enable(void)
+{
+    __asm__ volatile("sti" : : : "memory");
+}
+
+#endif
@@ -6,10 +6,35 @@
 #include "process.h"
 #include "scheduler.h"
 #include "ipc.h"
+#include "ata.h"
+#include "bcache.h"
+#include "multiboot.h"
+#include "initrd.h"
+#include "loader.h"
+#include "gdt.h"
+#include "syscall.h"
+#include "bench.h"
+#include "tsc.h"
+#include "stress.h"
+#include "bootprof.h"
+#include "percpu.h"
+#include "irq.h"
+#include "timer.h"
+#include "defer.h"
+#include "fiber.h"
+#include "cpu.h"
+#include "vga.h"
+#include "pmm.h"
+#include "paging.h"
+#include "shm.h"
+#include "spinlock.h"
 
 #define MAX_INPUT 128
 #define SHELL_STACK 4096
 #define WORKER_STACK 4096
+#define MAX_PROCESSES_SHOWN 24 /* distinct pids in one report, exited ones included */
+#define HEARTBEAT_RUNTIME_US 2000
+#define HEARTBEAT_PERIOD_US 1000000
 
 static ipc_queue_t global_queue;
 
@@ -20,26 +45,12 @@ static void busy_delay(void)
         ;
 }
 
-static void serial_putu(uint32_t value)
-{
-    char buf[11];
-    int idx = 0;
-    do
-    {
-        buf[idx++] = (char)('0' + (value % 10));
-        value /= 10;
-    } while (value && idx < 10);
-    while (idx--)
-    {
-        serial_putc(buf[idx]);
-    }
-}
-
 static void idle_process(void *arg)
 {
     (void)arg;
     while (1)
     {
+        serial_poll();
         scheduler_yield();
     }
 }
@@ -48,9 +59,17 @@ static void heartbeat_process(void *arg)
 {
     (void)arg;
     uint32_t tick = 0;
+    /* Tick once a second as a deadline process; busy-wait if not admitted */
+    int periodic = scheduler_set_deadline(process_current(), HEARTBEAT_RUNTIME_US,
+                                          HEARTBEAT_PERIOD_US, HEARTBEAT_PERIOD_US) == 0;
     /* Wait at startup so welcome message is visible */
     for (int i = 0; i < 5; i++)
     {
+        if (periodic)
+        {
+            scheduler_dl_wait();
+            continue;
+        }
         busy_delay();
         scheduler_yield();
     }
@@ -59,6 +78,11 @@ static void heartbeat_process(void *arg)
         serial_puts("[heartbeat] tick ");
         serial_putu(tick++);
         serial_puts("\n");
+        if (periodic && process_current()->sched_class == SCHED_DEADLINE)
+        {
+            scheduler_dl_wait();
+            continue;
+        }
         busy_delay();
         scheduler_yield();
     }
@@ -78,6 +102,31 @@ static void receiver_process(void *arg)
     }
 }
 
+static const char *skip_spaces(const char *p)
+{
+    while (*p == ' ')
+        p++;
+    return p;
+}
+
+/* Parse an unsigned decimal; returns the position after it or 0 if none */
+static const char *parse_uint(const char *p, uint32_t *out)
+{
+    p = skip_spaces(p);
+    if (*p < '0' || *p > '9')
+    {
+        return 0;
+    }
+    uint32_t value = 0;
+    while (*p >= '0' && *p <= '9')
+    {
+        value = value * 10 + (uint32_t)(*p - '0');
+        p++;
+    }
+    *out = value;
+    return p;
+}
+
 static int parse_send_command(const char *input)
 {
     const char *p = input;
@@ -102,7 +151,16 @@ static int parse_help_command(const char *input)
     {
         return 0;
     }
-    serial_puts("Commands: help, send <num>, ps, mem\n");
+    serial_puts("Commands: help, send <num>, ps, mem [profile], disk, cache, ls, cat <file>,\n");
+    serial_puts("          run <program> (e.g. hello, sysbench), bench, stress, boot,\n");
+    serial_puts("          cpu [trace [on | off]], irq, fibers [count], dl,\n");
+    serial_puts("          console [serial | vga | both], vm [clone <count> | shm <name> <kb>],\n");
+    serial_puts("          locks [timing on | timing off | reset], arena [<pid> quota <kb>]\n");
+    serial_puts("  disk [read <blk> <count> | write <blk> <text>]\n");
+    serial_puts("  cache [size <bufs> | ra <blocks> | sync | reset]\n");
+    serial_puts("  dl [<pid> <runtime_us> <deadline_us> <period_us> | <pid> off]\n");
+    serial_puts("  stress [cpu=N pairs=N churn=N spawn=N ms=N size=MIN-MAX\n");
+    serial_puts("          dist=uniform|small|bimodal]\n");
     return 1;
 }
 
@@ -112,7 +170,7 @@ static int parse_ps_command(const char *input)
     {
         return 0;
     }
-    serial_puts("PID  STATE      STACK\n");
+    serial_puts("PID  STATE      STACK  PEAK\n");
     for (int i = 0; i < process_get_count(); i++)
     {
         process_t *p = process_get_by_index(i);
@@ -132,14 +190,150 @@ static int parse_ps_command(const char *input)
         serial_puts(state);
         serial_puts("   ");
         serial_putu(p->stack_size);
+        if (p->state == PROC_TERMINATED)
+        {
+            serial_puts("\n");
+            continue;
+        }
+        size_t peak = process_stack_peak(p);
+        serial_puts("   ");
+        serial_putu(peak);
+        if (peak * 100 >= p->stack_size * PROCESS_STACK_WARN_PERCENT)
+        {
+            serial_puts("  near overflow");
+        }
         serial_puts("\n");
     }
     return 1;
 }
 
+static void print_counter(const char *label, uint32_t value)
+{
+    serial_puts(label);
+    serial_putu(value);
+    serial_puts("\n");
+}
+
+#ifdef CONFIG_HEAP_PROFILE
+static void print_hex(uint32_t value)
+{
+    static const char digits[] = "0123456789abcdef";
+    serial_puts("0x");
+    for (int shift = 28; shift >= 0; shift -= 4)
+    {
+        serial_putc(digits[(value >> shift) & 0xF]);
+    }
+}
+
+#define MEM_PROFILE_TOP 8
+
+typedef struct owner_total
+{
+    int pid;
+    uint32_t count;
+    uint32_t bytes;
+} owner_total_t;
+
+typedef struct owner_table
+{
+    owner_total_t owners[MAX_PROCESSES_SHOWN];
+    uint32_t used;
+} owner_table_t;
+
+static void count_owner(const void *ptr, uint32_t size, uintptr_t caller, int pid, void *ctx)
+{
+    (void)ptr;
+    (void)caller;
+    owner_table_t *t = (owner_table_t *)ctx;
+    uint32_t i = 0;
+    while (i < t->used && t->owners[i].pid != pid)
+        i++;
+    if (i == t->used)
+    {
+        if (t->used == MAX_PROCESSES_SHOWN)
+            return;
+        t->owners[t->used++] = (owner_total_t){pid, 0, 0};
+    }
+    t->owners[i].count++;
+    t->owners[i].bytes += size;
+}
+
+static void print_heap_profile(void)
+{
+    const heap_profile_t *prof = heap_profile_get();
+    print_counter("  allocations      ", prof->allocs);
+    print_counter("  frees            ", prof->frees);
+    print_counter("  failures         ", prof->failures);
+    print_counter("  bytes in use     ", prof->in_use);
+    print_counter("  peak bytes       ", prof->peak);
+    print_counter("  peak frag %      ", prof->peak_frag_percent);
+
+    serial_puts("Size class      ALLOCS  LIVE\n");
+    for (uint32_t cls = 0; cls < HEAP_PROFILE_CLASSES; cls++)
+    {
+        if (!prof->class_allocs[cls])
+            continue;
+        serial_puts(cls == HEAP_PROFILE_CLASSES - 1 ? "  >" : "  <=");
+        serial_putu(16u << (cls == HEAP_PROFILE_CLASSES - 1 ? cls - 1 : cls));
+        serial_puts("  ");
+        serial_putu(prof->class_allocs[cls]);
+        serial_puts("  ");
+        serial_putu(prof->class_live[cls]);
+        serial_puts("\n");
+    }
+
+    /* Selection of the sites with the most bytes, largest first */
+    serial_puts("Top call sites  BYTES  ALLOCS  LIVE  LIVE BYTES\n");
+    uint32_t shown = 0; /* bit i: site i already printed */
+    for (int n = 0; n < MEM_PROFILE_TOP; n++)
+    {
+        int best_i = -1;
+        for (int i = 0; i < HEAP_PROFILE_SITES; i++)
+        {
+            const heap_site_t *s = &prof->sites[i];
+            if (s->caller && !(shown & (1u << i)) &&
+                (best_i < 0 || s->bytes > prof->sites[best_i].bytes))
+                best_i = i;
+        }
+        if (best_i < 0)
+            break;
+        shown |= 1u << best_i;
+        const heap_site_t *best = &prof->sites[best_i];
+        serial_puts("  ");
+        print_hex((uint32_t)best->caller);
+        serial_puts("  ");
+        serial_putu(best->bytes);
+        serial_puts("  ");
+        serial_putu(best->allocs);
+        serial_puts("  ");
+        serial_putu(best->live);
+        serial_puts("  ");
+        serial_putu(best->live_bytes);
+        serial_puts("\n");
+    }
+    if (prof->untracked_allocs)
+        print_counter("  untracked allocs ", prof->untracked_allocs);
+
+    owner_table_t table;
+    table.used = 0;
+    heap_profile_walk(count_owner, &table);
+    serial_puts("Outstanding by process\n");
+    for (uint32_t i = 0; i < table.used; i++)
+    {
+        serial_puts("  pid ");
+        serial_putu((uint32_t)table.owners[i].pid);
+        serial_puts(": ");
+        serial_putu(table.owners[i].count);
+        serial_puts(" blocks, ");
+        serial_putu(table.owners[i].bytes);
+        serial_puts(" bytes\n");
+    }
+}
+#endif
+
 static int parse_mem_command(const char *input)
 {
-    if (strcmp(input, "mem") != 0)
+    if (strncmp(input, "mem", 3) != 0 || (input[3] && input[3] != ' '))
     {
         return 0;
     }
@@ -149,10 +343,854 @@ static int parse_mem_command(const char *input)
     serial_putu(total_free);
     serial_puts(" bytes, largest block: ");
     serial_putu(largest);
-    serial_puts(" bytes\n");
+    serial_puts(" bytes, fragmentation: ");
+    serial_putu(memory_fragmentation_percent());
+    serial_puts("%\n");
+
+    const char *p = skip_spaces(input + 3);
+    if (strcmp(p, "profile") == 0)
+    {
+#ifdef CONFIG_HEAP_PROFILE
+        print_heap_profile();
+#else
+        serial_puts("Heap profiling is compiled out; rebuild with 'make clean && make PROFILE=1'\n");
+#endif
+    }
+    else if (*p)
+    {
+        serial_puts("Usage: mem [profile]\n");
+    }
     return 1;
 }
 
+static int parse_disk_command(const char *input)
+{
+    if (strncmp(input, "disk", 4) != 0 || (input[4] && input[4] != ' '))
+    {
+        return 0;
+    }
+    if (!ata_present())
+    {
+        serial_puts("No disk attached\n");
+        return 1;
+    }
+
+    const char *p = skip_spaces(input + 4);
+    uint32_t blk, count;
+    if (!*p)
+    {
+        serial_puts("Disk: ");
+        serial_putu(ata_sector_count());
+        serial_puts(" sectors (");
+        serial_putu(ata_sector_count() / 2);
+        serial_puts(" KB), ");
+        serial_puts(ata_dma_enabled() ? "bus-master DMA\n" : "PIO\n");
+    }
+    else if (strncmp(p, "read", 4) == 0 && (p = parse_uint(p + 4, &blk)) &&
+             (p = parse_uint(p, &count)))
+    {
+        uint8_t chunk[BCACHE_BLOCK_SIZE];
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (bcache_read(blk + i, 0, chunk, BCACHE_BLOCK_SIZE) < 0)
+            {
+                serial_puts("Read error at block ");
+                serial_putu(blk + i);
+                serial_puts("\n");
+                return 1;
+            }
+            for (uint32_t j = 0; j < BCACHE_BLOCK_SIZE; j++)
+            {
+                sum += chunk[j];
+            }
+        }
+        serial_puts("Read ");
+        serial_putu(count);
+        serial_puts(" blocks, checksum ");
+        serial_putu(sum);
+        serial_puts("\n");
+    }
+    else if (strncmp(p, "write", 5) == 0 && (p = parse_uint(p + 5, &blk)))
+    {
+        p = skip_spaces(p);
+        if (bcache_write(blk, 0, p, strlen(p) + 1) < 0)
+        {
+            serial_puts("Write error\n");
+            return 1;
+        }
+        serial_puts("Wrote block ");
+        serial_putu(blk);
+        serial_puts(" (cached, run 'cache sync' to flush)\n");
+    }
+    else
+    {
+        serial_puts("Usage: disk [read <blk> <count> | write <blk> <text>]\n");
+    }
+    return 1;
+}
+
+static int parse_cache_command(const char *input)
+{
+    if (strncmp(input, "cache", 5) != 0 || (input[5] && input[5] != ' '))
+    {
+        return 0;
+    }
+
+    const char *p = skip_spaces(input + 5);
+    uint32_t value;
+    if (strncmp(p, "size", 4) == 0 && parse_uint(p + 4, &value))
+    {
+        if (bcache_resize(value) < 0)
+        {
+            serial_puts("Resize failed (buffers busy or out of heap)\n");
+            return 1;
+        }
+    }
+    else if (strncmp(p, "ra", 2) == 0 && parse_uint(p + 2, &value))
+    {
+        bcache_set_readahead(value);
+    }
+    else if (strcmp(p, "sync") == 0)
+    {
+        if (bcache_sync() < 0)
+            serial_puts("Sync failed\n");
+    }
+    else if (strcmp(p, "reset") == 0)
+    {
+        bcache_reset_stats();
+    }
+    else if (*p)
+    {
+        serial_puts("Usage: cache [size <bufs> | ra <blocks> | sync | reset]\n");
+        return 1;
+    }
+
+    bcache_stats_t st;
+    bcache_get_stats(&st);
+    uint32_t lookups = st.hits + st.misses;
+    serial_puts("Cache: ");
+    serial_putu(st.nbufs);
+    serial_puts(" x ");
+    serial_putu(BCACHE_BLOCK_SIZE);
+    serial_puts(" bytes, read-ahead ");
+    serial_putu(st.readahead_window);
+    serial_puts(" blocks\n");
+    serial_puts("  hits ");
+    serial_putu(st.hits);
+    serial_puts(", misses ");
+    serial_putu(st.misses);
+    serial_puts(", hit rate ");
+    serial_putu(lookups ? st.hits * 100 / lookups : 0);
+    serial_puts("%\n");
+    serial_puts("  read-ahead ");
+    serial_putu(st.readahead_blocks);
+    serial_puts(" blocks, ");
+    serial_putu(st.readahead_hits);
+    serial_puts(" used\n");
+    serial_puts("  writebacks ");
+    serial_putu(st.writebacks);
+    serial_puts(", evictions ");
+    serial_putu(st.evictions);
+    serial_puts(", dirty ");
+    serial_putu(st.dirty);
+    serial_puts("\n");
+    return 1;
+}
+
+static int parse_ls_command(const char *input)
+{
+    if (strcmp(input, "ls") != 0)
+    {
+        return 0;
+    }
+    if (!initrd_count())
+    {
+        serial_puts("No initrd files (boot with -initrd)\n");
+        return 1;
+    }
+    for (int fd = 0; fd < initrd_count(); fd++)
+    {
+        uint32_t len;
+        const char *name = initrd_name(fd, &len);
+        for (uint32_t i = 0; i < len; i++)
+        {
+            serial_putc(name[i]);
+        }
+        serial_puts("  ");
+        serial_putu(initrd_size(fd));
+        serial_puts(" bytes\n");
+    }
+    return 1;
+}
+
+static int parse_cat_command(const char *input)
+{
+    if (strncmp(input, "cat ", 4) != 0)
+    {
+        return 0;
+    }
+    int fd = initrd_open(skip_spaces(input + 4));
+    if (fd < 0)
+    {
+        serial_puts("No such file\n");
+        return 1;
+    }
+    uint32_t size;
+    const char *data = (const char *)initrd_map(fd, &size);
+    for (uint32_t i = 0; i < size; i++)
+    {
+        serial_putc(data[i]);
+    }
+    if (size && data[size - 1] != '\n')
+    {
+        serial_puts("\n");
+    }
+    return 1;
+}
+
+static int parse_run_command(const char *input)
+{
+    if (strncmp(input, "run ", 4) != 0)
+    {
+        return 0;
+    }
+    process_t *proc = 0;
+    int rc = loader_spawn(skip_spaces(input + 4), &proc);
+    if (rc < 0)
+    {
+        serial_puts("run: ");
+        serial_puts(loader_strerror(rc));
+        serial_puts("\n");
+        return 1;
+    }
+    serial_puts("Started pid ");
+    serial_putu(proc->pid);
+    serial_puts("\n");
+    return 1;
+}
+
+static void print_trace(void)
+{
+    static const char *events[] = {"?", "switch", "block", "wake", "syscall"};
+    percpu_t *cpu = this_cpu->self;
+    uint32_t n = cpu->trace_next < PERCPU_TRACE_SIZE ? cpu->trace_next : PERCPU_TRACE_SIZE;
+    serial_puts("TSC(low)    PID  EVENT    ARG\n");
+    for (uint32_t i = cpu->trace_next - n; i != cpu->trace_next; i++)
+    {
+        trace_entry_t *e = &cpu->trace[i & (PERCPU_TRACE_SIZE - 1)];
+        serial_putu(e->tsc_low);
+        serial_puts("  ");
+        serial_putu(e->pid);
+        serial_puts("  ");
+        serial_puts(e->event <= TRACE_SYSCALL ? events[e->event] : events[0]);
+        serial_puts("  ");
+        serial_putu(e->arg);
+        serial_puts("\n");
+    }
+}
+
+static int parse_cpu_command(const char *input)
+{
+    if (strncmp(input, "cpu", 3) != 0 || (input[3] && input[3] != ' '))
+    {
+        return 0;
+    }
+
+    const char *p = skip_spaces(input + 3);
+    if (strcmp(p, "trace on") == 0 || strcmp(p, "trace off") == 0)
+    {
+        this_cpu->trace_on = (p[7] == 'n');
+        return 1;
+    }
+    if (strcmp(p, "trace") == 0)
+    {
+        print_trace();
+        return 1;
+    }
+    if (*p)
+    {
+        serial_puts("Usage: cpu [trace [on | off]]\n");
+        return 1;
+    }
+
+    percpu_stats_t *st = &this_cpu->self->stats;
+    serial_puts("CPU ");
+    serial_putu(this_cpu->cpu_id);
+    serial_puts(this_cpu->trace_on ? " (tracing)\n" : "\n");
+    print_counter("  context switches ", st->context_switches);
+    print_counter("  yields           ", st->yields);
+    print_counter("  blocks           ", st->blocks);
+    print_counter("  wakeups          ", st->wakeups);
+    print_counter("  ipc sends        ", st->ipc_sends);
+    print_counter("  ipc receives     ", st->ipc_recvs);
+    print_counter("  system calls     ", st->syscalls);
+    return 1;
+}
+
+static int parse_irq_command(const char *input)
+{
+    if (strcmp(input, "irq") != 0)
+    {
+        return 0;
+    }
+    static const char *names[IRQ_LINES] = {"timer", 0, 0, 0, "com1"};
+    serial_puts("IRQ  NAME    COUNT      MAX CYCLES\n");
+    for (uint32_t line = 0; line < IRQ_LINES; line++)
+    {
+        irq_line_stats_t st;
+        irq_get_stats(line, &st);
+        if (!st.count)
+            continue;
+        serial_putu(line);
+        serial_puts("    ");
+        serial_puts(names[line] ? names[line] : "-");
+        serial_puts("   ");
+        serial_putu(st.count);
+        serial_puts("   ");
+        serial_putu(st.max_cycles);
+        serial_puts("\n");
+    }
+    percpu_stats_t *st = &this_cpu->self->stats;
+    print_counter("  ticks            ", timer_ticks());
+    print_counter("  spurious         ", irq_spurious_count());
+    print_counter("  rx bytes dropped ", serial_rx_dropped());
+    print_counter("  work queued      ", st->work_queued);
+    print_counter("  work coalesced   ", st->work_coalesced);
+    print_counter("  work run         ", st->work_run);
+    print_counter("  softirq passes   ", st->softirq_passes);
+    return 1;
+}
+
+static process_t *find_process(uint32_t pid)
+{
+    for (int i = 0; i < process_get_count(); i++)
+    {
+        process_t *p = process_get_by_index(i);
+        if (p->state != PROC_UNUSED && p->state != PROC_TERMINATED && (uint32_t)p->pid == pid)
+            return p;
+    }
+    return 0;
+}
+
+static void print_deadline_table(void)
+{
+    serial_puts("PID  RUNTIME  DEADLINE  PERIOD (us)  JOBS  MISSES  THROTTLED\n");
+    for (int i = 0; i < process_get_count(); i++)
+    {
+        process_t *p = process_get_by_index(i);
+        if (p->state == PROC_UNUSED || p->sched_class != SCHED_DEADLINE)
+            continue;
+        serial_putu(p->pid);
+        serial_puts("    ");
+        serial_putu(tsc_cycles_to_us(p->dl.runtime));
+        serial_puts("  ");
+        serial_putu(tsc_cycles_to_us(p->dl.deadline));
+        serial_puts("  ");
+        serial_putu(tsc_cycles_to_us(p->dl.period));
+        serial_puts("  ");
+        serial_putu(p->dl.jobs);
+        serial_puts("  ");
+        serial_putu(p->dl.misses);
+        serial_puts("  ");
+        serial_putu(p->dl.throttles);
+        serial_puts("\n");
+    }
+    uint32_t util = scheduler_dl_utilization();
+    serial_puts("Utilization: ");
+    serial_putu(util / 10000);
+    serial_puts(".");
+    serial_putu((util / 1000) % 10);
+    serial_puts("% of ");
+    serial_putu(SCHED_DL_MAX_UTIL_PPM / 10000);
+    serial_puts("%\n");
+}
+
+static int parse_dl_command(const char *input)
+{
+    if (strncmp(input, "dl", 2) != 0 || (input[2] && input[2] != ' '))
+    {
+        return 0;
+    }
+    const char *p = skip_spaces(input + 2);
+    if (!*p)
+    {
+        print_deadline_table();
+        return 1;
+    }
+
+    uint32_t pid, runtime, deadline, period;
+    process_t *proc;
+    if (!(p = parse_uint(p, &pid)) || !(proc = find_process(pid)))
+    {
+        serial_puts("Usage: dl [<pid> <runtime_us> <deadline_us> <period_us> | <pid> off]\n");
+        return 1;
+    }
+    p = skip_spaces(p);
+    if (strcmp(p, "off") == 0)
+    {
+        scheduler_clear_deadline(proc);
+        serial_puts("Deadline class cleared\n");
+    }
+    else if ((p = parse_uint(p, &runtime)) && (p = parse_uint(p, &deadline)) &&
+             parse_uint(p, &period))
+    {
+        if (scheduler_set_deadline(proc, runtime, deadline, period) < 0)
+            serial_puts("Rejected: needs runtime <= deadline <= period and spare utilization\n");
+        else
+            serial_puts("Admitted\n");
+    }
+    else
+    {
+        serial_puts("Usage: dl [<pid> <runtime_us> <deadline_us> <period_us> | <pid> off]\n");
+    }
+    return 1;
+}
+
+#define FIBER_DEMO_ROUNDS 4
+
+static void fiber_demo_task(void *arg)
+{
+    uint32_t *done = (uint32_t *)arg;
+    for (int i = 0; i < FIBER_DEMO_ROUNDS; i++)
+    {
+        fiber_yield();
+    }
+    (*done)++;
+}
+
+static int parse_fibers_command(const char *input)
+{
+    if (strncmp(input, "fibers", 6) != 0 || (input[6] && input[6] != ' '))
+    {
+        return 0;
+    }
+    uint32_t n = 100;
+    if (input[6] && !parse_uint(input + 6, &n))
+    {
+        serial_puts("Usage: fibers [count]\n");
+        return 1;
+    }
+
+    uint32_t done = 0, created = 0;
+    for (; created < n; created++)
+    {
+        fiber_t *f = fiber_create(fiber_demo_task, &done, FIBER_DEFAULT_STACK);
+        if (!f)
+            break;
+        fiber_detach(f);
+    }
+    uint64_t start = rdtsc();
+    fiber_run();
+    uint64_t cycles = rdtsc() - start;
+
+    uint32_t switches = created * (FIBER_DEMO_ROUNDS + 1);
+    serial_putu(done);
+    serial_puts(" of ");
+    serial_putu(n);
+    serial_puts(" fibers finished, ");
+    serial_putu(fiber_footprint(FIBER_DEFAULT_STACK));
+    serial_puts(" bytes each, ");
+    serial_putu(switches ? (uint32_t)udiv64_32(cycles, switches) : 0);
+    serial_puts(" cycles per switch\n");
+    return 1;
+}
+
+static int parse_console_command(const char *input)
+{
+    if (strncmp(input, "console", 7) != 0 || (input[7] && input[7] != ' '))
+    {
+        return 0;
+    }
+    const char *p = skip_spaces(input + 7);
+    if (strcmp(p, "serial") == 0)
+        serial_set_outputs(OUTPUT_SERIAL);
+    else if (strcmp(p, "vga") == 0)
+        serial_set_outputs(OUTPUT_VGA);
+    else if (strcmp(p, "both") == 0)
+        serial_set_outputs(OUTPUT_SERIAL | OUTPUT_VGA);
+    else if (*p)
+    {
+        serial_puts("Usage: console [serial | vga | both]\n");
+        return 1;
+    }
+
+    uint32_t outputs = serial_outputs();
+    serial_puts("Output: ");
+    serial_puts(outputs & OUTPUT_SERIAL ? "serial " : "");
+    serial_puts(outputs & OUTPUT_VGA ? "vga" : "");
+    serial_puts("\n");
+    vga_stats_t st;
+    vga_get_stats(&st);
+    print_counter("  vga chars        ", st.chars);
+    print_counter("  vga scrolls      ", st.scrolls);
+    print_counter("  vga flushes      ", st.flushes);
+    print_counter("  vga rows copied  ", st.rows_copied);
+    return 1;
+}
+
+static void print_arena_table(void)
+{
+    serial_puts("PID  CHUNKS  RESERVED  USED  QUOTA  ALLOCS  FAILED\n");
+    for (int i = 0; i < process_get_count(); i++)
+    {
+        process_t *p = process_get_by_index(i);
+        if (p->state == PROC_UNUSED || p->state == PROC_TERMINATED)
+            continue;
+        const arena_t *a = &p->arena;
+        serial_putu(p->pid);
+        serial_puts("    ");
+        serial_putu(a->nchunks);
+        serial_puts("  ");
+        serial_putu(a->reserved);
+        serial_puts("  ");
+        serial_putu(a->used);
+        serial_puts("  ");
+        if (a->quota)
+            serial_putu(a->quota);
+        else
+            serial_puts("-");
+        serial_puts("  ");
+        serial_putu(a->allocs);
+        serial_puts("  ");
+        serial_putu(a->failures);
+        serial_puts("\n");
+    }
+    arena_stats_t st;
+    arena_get_stats(&st);
+    print_counter("  chunks cached    ", st.chunks_cached);
+    print_counter("  chunks from heap ", st.heap_chunks);
+    print_counter("  chunks reused    ", st.reuses);
+    print_counter("  arenas released  ", st.releases);
+    print_counter("  chunks trimmed   ", st.trimmed);
+}
+
+static int parse_arena_command(const char *input)
+{
+    if (strncmp(input, "arena", 5) != 0 || (input[5] && input[5] != ' '))
+    {
+        return 0;
+    }
+    const char *p = skip_spaces(input + 5);
+    if (!*p)
+    {
+        print_arena_table();
+        return 1;
+    }
+
+    uint32_t pid, kb;
+    process_t *proc;
+    if (!(p = parse_uint(p, &pid)) || !(proc = find_process(pid)) ||
+        strncmp(p = skip_spaces(p), "quota", 5) != 0 || !parse_uint(p + 5, &kb) ||
+        kb > 0xFFFFFFFFu / 1024)
+    {
+        serial_puts("Usage: arena [<pid> quota <kb>]   (0 kb for no limit)\n");
+        return 1;
+    }
+    process_set_quota(proc, kb * 1024);
+    serial_puts("Quota set\n");
+    return 1;
+}
+
+static int parse_locks_command(const char *input)
+{
+    if (strncmp(input, "locks", 5) != 0 || (input[5] && input[5] != ' '))
+    {
+        return 0;
+    }
+    const char *p = skip_spaces(input + 5);
+    if (strcmp(p, "timing on") == 0)
+        lock_timing_set(1);
+    else if (strcmp(p, "timing off") == 0)
+        lock_timing_set(0);
+    else if (strcmp(p, "reset") == 0)
+        lock_stats_reset();
+    else if (*p)
+    {
+        serial_puts("Usage: locks [timing on | timing off | reset]\n");
+        return 1;
+    }
+
+    serial_puts("LOCK            ACQUIRED   CONTENDED  SPIN us  MAX HOLD CYCLES\n");
+    for (const lock_stats_t *s = lock_stats_first(); s; s = s->next)
+    {
+        serial_puts(s->name);
+        for (size_t len = strlen(s->name); len < 16; len++)
+            serial_putc(' ');
+        serial_putu(s->acquisitions);
+        serial_puts("   ");
+        serial_putu(s->contended);
+        serial_puts("   ");
+        serial_putu(tsc_cycles_to_us(s->spin_cycles));
+        serial_puts("   ");
+        serial_putu(s->max_hold_cycles);
+        serial_puts("\n");
+    }
+    serial_puts(lock_timing ? "Hold timing on\n" : "Hold timing off (locks timing on)\n");
+    return 1;
+}
+
+#define VM_DEMO_BYTES (64 * 1024)
+
+/* Private to the shell; clones see it copy-on-write */
+static uint8_t *vm_demo_data;
+/* A shared segment; every clone increments the same counter */
+static volatile uint32_t *vm_demo_counter;
+static uint32_t vm_demo_done;
+
+static void vm_demo_worker(void *arg)
+{
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < VM_DEMO_BYTES; i += PAGE_SIZE)
+    {
+        sum += vm_demo_data[i];
+    }
+    vm_demo_data[(index * PAGE_SIZE) % VM_DEMO_BYTES] = (uint8_t)sum; /* one page copied */
+    (*vm_demo_counter)++;
+    vm_demo_done++;
+}
+
+static void vm_clone_demo(uint32_t count)
+{
+    /* Whichever half was set up before is kept; only the rest is retried.
+     * shm_open finds the segment again if only the map failed. */
+    if (!vm_demo_counter)
+    {
+        int id = shm_open("vmdemo", PAGE_SIZE);
+        vm_demo_counter = id < 0 ? 0 : (volatile uint32_t *)shm_map(id);
+    }
+    if (vm_demo_counter && !vm_demo_data)
+    {
+        vm_demo_data = (uint8_t *)vm_alloc(VM_DEMO_BYTES);
+        if (vm_demo_data)
+            memset(vm_demo_data, 1, VM_DEMO_BYTES);
+    }
+    if (!vm_demo_data || !vm_demo_counter)
+    {
+        serial_puts("No memory for the demo (is paging on?)\n");
+        return;
+    }
+
+    vm_stats_t before, after;
+    vm_get_stats(&before);
+    uint32_t free_before = pmm_free_frames();
+    uint32_t start_count = *vm_demo_counter;
+    vm_demo_done = 0;
+
+    uint32_t created = 0;
+    uint64_t start = rdtsc();
+    for (; created < count; created++)
+    {
+        if (!process_clone(vm_demo_worker, (void *)(uintptr_t)created, WORKER_STACK))
+            break;
+    }
+    uint64_t cycles = rdtsc() - start;
+    uint32_t frames_used = free_before - pmm_free_frames();
+    while (vm_demo_done < created)
+    {
+        scheduler_yield();
+    }
+    vm_get_stats(&after);
+
+    serial_putu(created);
+    serial_puts(" clones of ");
+    serial_putu(VM_DEMO_BYTES / 1024);
+    serial_puts(" KB: ");
+    serial_putu(created ? (uint32_t)udiv64_32(cycles, created) : 0);
+    serial_puts(" cycles and ");
+    serial_putu(created ? frames_used / created : 0);
+    serial_puts(" frames each at clone time\n");
+    print_counter("  cow faults       ", after.cow_faults - before.cow_faults);
+    print_counter("  pages copied     ", after.cow_copies - before.cow_copies);
+    print_counter("  shared counter + ", *vm_demo_counter - start_count);
+}
+
+static int parse_vm_command(const char *input)
+{
+    if (strncmp(input, "vm", 2) != 0 || (input[2] && input[2] != ' '))
+    {
+        return 0;
+    }
+    const char *p = skip_spaces(input + 2);
+    uint32_t value;
+    if (strncmp(p, "clone", 5) == 0 && parse_uint(p + 5, &value))
+    {
+        vm_clone_demo(value);
+        return 1;
+    }
+    if (strncmp(p, "shm ", 4) == 0)
+    {
+        char name[SHM_NAME_MAX];
+        p = skip_spaces(p + 4);
+        size_t len = 0;
+        while (p[len] && p[len] != ' ' && len < SHM_NAME_MAX - 1)
+        {
+            name[len] = p[len];
+            len++;
+        }
+        name[len] = 0;
+        int id = parse_uint(p + len, &value) ? shm_open(name, value * 1024) : -1;
+        void *addr = id < 0 ? 0 : shm_map(id);
+        if (!addr)
+        {
+            serial_puts("Usage: vm shm <name> <kb> (fails when out of memory or slots)\n");
+            return 1;
+        }
+        serial_puts("Mapped at ");
+        serial_putu((uint32_t)(uintptr_t)addr);
+        serial_puts("\n");
+        return 1;
+    }
+    if (*p)
+    {
+        serial_puts("Usage: vm [clone <count> | shm <name> <kb>]\n");
+        return 1;
+    }
+
+    vm_stats_t st;
+    vm_get_stats(&st);
+    serial_puts("Frames: ");
+    serial_putu(pmm_free_frames());
+    serial_puts(" free of ");
+    serial_putu(pmm_total_frames());
+    serial_puts("\n");
+    print_counter("  clones           ", st.clones);
+    print_counter("  pages shared     ", st.pages_shared);
+    print_counter("  cow faults       ", st.cow_faults);
+    print_counter("  cow copies       ", st.cow_copies);
+    print_counter("  cow reuses       ", st.cow_reuses);
+    for (int i = 0; i < process_get_count(); i++)
+    {
+        process_t *proc = process_get_by_index(i);
+        uint32_t pages = vm_private_pages(proc);
+        if (proc->state == PROC_UNUSED || proc->state == PROC_TERMINATED || !pages)
+            continue;
+        serial_puts("  pid ");
+        serial_putu(proc->pid);
+        serial_puts(": ");
+        serial_putu(pages);
+        serial_puts(" pages mapped\n");
+    }
+    for (int id = 0; id < SHM_MAX_SEGMENTS; id++)
+    {
+        shm_info_t info;
+        if (shm_get_info(id, &info) < 0)
+            continue;
+        serial_puts("  shm ");
+        serial_puts(info.name);
+        serial_puts(": ");
+        serial_putu(info.pages);
+        serial_puts(" pages, mapped ");
+        serial_putu(info.mappers);
+        serial_puts(" times\n");
+    }
+    return 1;
+}
+
+static int parse_boot_command(const char *input)
+{
+    if (strcmp(input, "boot") != 0)
+    {
+        return 0;
+    }
+    bootprof_report();
+    return 1;
+}
+
+static int parse_bench_command(const char *input)
+{
+    if (strcmp(input, "bench") != 0)
+    {
+        return 0;
+    }
+    bench_run_all();
+    return 1;
+}
+
+/* Parse one 'key=value' stress option; returns the position after it or 0 */
+static const char *parse_stress_option(const char *p, stress_config_t *cfg)
+{
+    const struct
+    {
+        const char *key;
+        uint32_t *field;
+    } counts[] = {
+        {"cpu=", &cfg->cpu},
+        {"pairs=", &cfg->pairs},
+        {"churn=", &cfg->churn},
+        {"spawn=", &cfg->spawners},
+        {"ms=", &cfg->duration_ms},
+    };
+
+    for (uint32_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        size_t len = strlen(counts[i].key);
+        if (strncmp(p, counts[i].key, len) == 0)
+        {
+            return parse_uint(p + len, counts[i].field);
+        }
+    }
+    if (strncmp(p, "size=", 5) == 0)
+    {
+        p = parse_uint(p + 5, &cfg->size_min);
+        if (!p || *p != '-')
+            return 0;
+        return parse_uint(p + 1, &cfg->size_max);
+    }
+    if (strncmp(p, "dist=", 5) == 0)
+    {
+        static const char *names[] = {"uniform", "small", "bimodal"};
+        for (uint32_t d = 0; d < 3; d++)
+        {
+            size_t len = strlen(names[d]);
+            if (strncmp(p + 5, names[d], len) == 0 && (p[5 + len] == ' ' || !p[5 + len]))
+            {
+                cfg->dist = d;
+                return p + 5 + len;
+            }
+        }
+    }
+    return 0;
+}
+
+static int parse_stress_command(const char *input)
+{
+    if (strncmp(input, "stress", 6) != 0 || (input[6] && input[6] != ' '))
+    {
+        return 0;
+    }
+
+    stress_config_t cfg;
+    stress_default_config(&cfg);
+    const char *p = skip_spaces(input + 6);
+    while (*p)
+    {
+        p = parse_stress_option(p, &cfg);
+        if (!p)
+        {
+            serial_puts("Usage: stress [cpu=N pairs=N churn=N spawn=N ms=N size=MIN-MAX\n");
+            serial_puts("              dist=uniform|small|bimodal]\n");
+            return 1;
+        }
+        p = skip_spaces(p);
+    }
+
+    if (stress_run(&cfg) < 0)
+    {
+        serial_puts("stress: size range must be non-empty and start above 0\n");
+    }
+    return 1;
+}
+
+/* Headless benchmark run ('make bench'): report, then power off QEMU */
+static void bench_process(void *arg)
+{
+    (void)arg;
+    bench_run_all();
+    bench_qemu_exit(0);
+}
+
 static void shell_process(void *arg)
 {
     (void)arg;
@@ -168,7 +1206,7 @@ static void shell_process(void *arg)
         {
             while (!serial_available())
             {
-                scheduler_yield();
+                serial_wait_input();
             }
             char c = serial_getc();
 
@@ -195,7 +1233,23 @@ static void shell_process(void *arg)
             if (!parse_help_command(input) &&
                 !parse_send_command(input) &&
                 !parse_ps_command(input) &&
-                !parse_mem_command(input))
+                !parse_mem_command(input) &&
+                !parse_disk_command(input) &&
+                !parse_cache_command(input) &&
+                !parse_ls_command(input) &&
+                !parse_cat_command(input) &&
+                !parse_run_command(input) &&
+                !parse_boot_command(input) &&
+                !parse_cpu_command(input) &&
+                !parse_irq_command(input) &&
+                !parse_fibers_command(input) &&
+                !parse_dl_command(input) &&
+                !parse_console_command(input) &&
+                !parse_vm_command(input) &&
+                !parse_locks_command(input) &&
+                !parse_arena_command(input) &&
+                !parse_bench_command(input) &&
+                !parse_stress_command(input))
             {
                 serial_puts("You typed: ");
                 serial_puts(input);
@@ -207,30 +1261,99 @@ static void shell_process(void *arg)
     }
 }
 
-void kmain(void)
+void kmain(uint32_t magic, const multiboot_info_t *mbi)
 {
+    bootprof_mark("entry + bss clear");
+    string_init();
+    multiboot_init(magic, mbi);
+    gdt_init();
+    percpu_init(0); /* before anything touches this_cpu */
+    irq_init();
+    bootprof_mark("cpu setup");
     serial_init();
+    if (multiboot_cmdline_has("console=vga"))
+    {
+        serial_set_outputs(OUTPUT_VGA);
+    }
+    else if (multiboot_cmdline_has("console=both"))
+    {
+        serial_set_outputs(OUTPUT_SERIAL | OUTPUT_VGA);
+    }
+    bootprof_mark("serial_init");
     memory_init();
     process_init();
     scheduler_init();
+    bootprof_mark("memory/process/sched");
 
+    /* Queued in the serial TX ring; drains while the rest of boot runs */
     serial_puts("\n");
     serial_puts("========================================\n");
     serial_puts("    kacchiOS - Minimal Baremetal OS\n");
     serial_puts("========================================\n");
     serial_puts("Hello from kacchiOS!\n");
+    bootprof_mark("banner");
+
+    if (!syscall_init())
+    {
+        serial_puts("CPU has no SYSENTER; 'run' is unavailable\n");
+    }
+    bootprof_mark("syscall_init");
+    if (paging_init() < 0)
+    {
+        serial_puts("No memory above the kernel; paging is off\n");
+    }
+    bootprof_mark("paging_init");
+    if (initrd_init())
+    {
+        serial_puts("initrd: ");
+        serial_putu(initrd_count());
+        serial_puts(" files\n");
+    }
+    bootprof_mark("initrd_init");
+    if (ata_init())
+    {
+        serial_puts("Disk: ");
+        serial_putu(ata_sector_count());
+        serial_puts(ata_dma_enabled() ? " sectors, DMA\n" : " sectors, PIO\n");
+        if (bcache_init(BCACHE_DEFAULT_BUFS) < 0)
+        {
+            serial_puts("Disk: buffer cache allocation failed\n");
+        }
+    }
+    bootprof_mark("ata_init + bcache");
     serial_puts("Starting scheduler demo...\n\n");
 
+    if (timer_init() < 0 || serial_enable_irq() < 0)
+    {
+        serial_puts("IRQ setup failed\n");
+    }
+    defer_start_worker();
+    bootprof_mark("timer/uart irqs");
+
     ipc_init(&global_queue);
+    syscall_register_queue(0, &global_queue);
+    if (multiboot_cmdline_has("bench"))
+    {
+        process_create(bench_process, 0, SHELL_STACK);
+        bootprof_mark("process creation");
+        irq_enable();
+        scheduler_start();
+        for (;;)
+        {
+            __asm__ volatile("hlt");
+        }
+    }
     process_create(shell_process, 0, SHELL_STACK);
     process_create(heartbeat_process, 0, WORKER_STACK);
     process_create(receiver_process, 0, WORKER_STACK);
     process_create(idle_process, 0, WORKER_STACK);
+    bootprof_mark("process creation");
 
+    irq_enable();
     scheduler_start();
 
     for (;;)
     {
         __asm__ volatile("hlt");
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,332 @@
+/* loader.c - Launch ELF32 executables from the initrd as processes
+ *
+ * Physical memory is identity mapped (paging.h), so a program runs at the
+ * physical addresses it was linked for, below the page frame pool.
+ * Read-only segments are copied out of the boot module once and reused
+ * by every later launch; only writable segments (.data, .bss) are
+ * re-initialised per launch. Because those writable pages are not
+ * private, a program with a writable segment runs one instance at a time,
+ * while purely read-only programs may run concurrently.
+ *
+ * Programs run in ring 3 and reach the kernel through SYSENTER system
+ * calls (programs/usys.h).
+ */
+#include "loader.h"
+#include "elf.h"
+#include "initrd.h"
+#include "multiboot.h"
+#include "pmm.h"
+#include "string.h"
+#include "syscall.h"
+
+extern uint8_t __kernel_end[];
+
+typedef struct program
+{
+    int fd; /* initrd handle, -1 if the slot is free */
+    const uint8_t *image;
+    uint32_t image_size;
+    uint32_t entry;
+    uint32_t lo; /* lowest and highest address touched by PT_LOAD */
+    uint32_t hi;
+    int has_writable;
+    int text_loaded;
+    int instances;
+} program_t;
+
+typedef struct instance
+{
+    process_t *proc;
+    program_t *prog;
+} instance_t;
+
+static program_t programs[LOADER_MAX_PROGRAMS];
+static instance_t instances[LOADER_MAX_INSTANCES];
+static int loader_ready = 0;
+
+static void loader_setup(void)
+{
+    for (int i = 0; i < LOADER_MAX_PROGRAMS; i++)
+    {
+        programs[i].fd = -1;
+    }
+    loader_ready = 1;
+}
+
+static const elf32_phdr_t *phdr_at(const program_t *prog, int idx)
+{
+    const elf32_ehdr_t *eh = (const elf32_ehdr_t *)prog->image;
+    return (const elf32_phdr_t *)(prog->image + eh->e_phoff) + idx;
+}
+
+/* Validate the headers and record the load span; 0 on success */
+static int parse_image(program_t *prog)
+{
+    const elf32_ehdr_t *eh = (const elf32_ehdr_t *)prog->image;
+    if (prog->image_size < sizeof(elf32_ehdr_t) ||
+        eh->e_ident[0] != 0x7F || eh->e_ident[1] != 'E' ||
+        eh->e_ident[2] != 'L' || eh->e_ident[3] != 'F' ||
+        eh->e_ident[4] != ELFCLASS32 || eh->e_ident[5] != ELFDATA2LSB ||
+        eh->e_type != ET_EXEC || eh->e_machine != EM_386 ||
+        eh->e_phentsize != sizeof(elf32_phdr_t) || eh->e_phoff > prog->image_size ||
+        (uint32_t)eh->e_phnum * sizeof(elf32_phdr_t) > prog->image_size - eh->e_phoff)
+    {
+        return LOADER_ENOEXEC;
+    }
+
+    prog->entry = eh->e_entry;
+    prog->lo = 0xFFFFFFFF;
+    prog->hi = 0;
+    prog->has_writable = 0;
+
+    for (int i = 0; i < eh->e_phnum; i++)
+    {
+        const elf32_phdr_t *ph = phdr_at(prog, i);
+        if (ph->p_type != PT_LOAD || !ph->p_memsz)
+        {
+            continue;
+        }
+        /* Subtract rather than add: an offset near 4 GB must not wrap */
+        if (ph->p_filesz > ph->p_memsz || ph->p_offset > prog->image_size ||
+            ph->p_filesz > prog->image_size - ph->p_offset ||
+            ph->p_vaddr + ph->p_memsz < ph->p_vaddr)
+        {
+            return LOADER_ENOEXEC;
+        }
+        if (ph->p_vaddr < prog->lo)
+            prog->lo = ph->p_vaddr;
+        if (ph->p_vaddr + ph->p_memsz > prog->hi)
+            prog->hi = ph->p_vaddr + ph->p_memsz;
+        if (ph->p_flags & PF_W)
+            prog->has_writable = 1;
+    }
+
+    if (prog->hi <= prog->lo || prog->entry < prog->lo || prog->entry >= prog->hi)
+    {
+        return LOADER_ENOEXEC;
+    }
+    return LOADER_OK;
+}
+
+static int overlaps(uint32_t lo1, uint32_t hi1, uint32_t lo2, uint32_t hi2)
+{
+    return lo1 < hi2 && lo2 < hi1;
+}
+
+/* The load span must sit in free RAM above the kernel and clear of modules */
+static int check_range(const program_t *prog)
+{
+    if (prog->lo < (uint32_t)__kernel_end)
+    {
+        return LOADER_ERANGE;
+    }
+    uint32_t upper_kb = multiboot_mem_upper_kb();
+    if ((upper_kb && prog->hi > 0x100000 + upper_kb * 1024) || prog->hi > PMM_BASE)
+    {
+        return LOADER_ERANGE;
+    }
+    for (int i = 0; i < multiboot_module_count(); i++)
+    {
+        const multiboot_module_t *mod = multiboot_get_module(i);
+        if (overlaps(prog->lo, prog->hi, mod->mod_start, mod->mod_end))
+        {
+            return LOADER_ERANGE;
+        }
+    }
+
+    /* Other resident programs linked at the same place give way if idle */
+    for (int i = 0; i < LOADER_MAX_PROGRAMS; i++)
+    {
+        program_t *other = &programs[i];
+        if (other == prog || other->fd < 0 || !other->text_loaded ||
+            !overlaps(prog->lo, prog->hi, other->lo, other->hi))
+        {
+            continue;
+        }
+        if (other->instances)
+        {
+            return LOADER_EBUSY;
+        }
+    }
+    for (int i = 0; i < LOADER_MAX_PROGRAMS; i++)
+    {
+        program_t *other = &programs[i];
+        if (other != prog && other->fd >= 0 && other->text_loaded &&
+            overlaps(prog->lo, prog->hi, other->lo, other->hi))
+        {
+            other->text_loaded = 0;
+        }
+    }
+    return LOADER_OK;
+}
+
+/* Copy file contents and zero the remainder of matching PT_LOAD segments */
+static void load_segments(const program_t *prog, int writable)
+{
+    const elf32_ehdr_t *eh = (const elf32_ehdr_t *)prog->image;
+    for (int i = 0; i < eh->e_phnum; i++)
+    {
+        const elf32_phdr_t *ph = phdr_at(prog, i);
+        if (ph->p_type != PT_LOAD || !ph->p_memsz ||
+            ((ph->p_flags & PF_W) != 0) != writable)
+        {
+            continue;
+        }
+        uint8_t *dst = (uint8_t *)ph->p_vaddr;
+        memcpy(dst, prog->image + ph->p_offset, ph->p_filesz);
+        memset(dst + ph->p_filesz, 0, ph->p_memsz - ph->p_filesz);
+    }
+}
+
+static program_t *find_program(int fd)
+{
+    program_t *free_slot = 0;
+    program_t *idle_slot = 0;
+    for (int i = 0; i < LOADER_MAX_PROGRAMS; i++)
+    {
+        program_t *prog = &programs[i];
+        if (prog->fd == fd)
+        {
+            return prog;
+        }
+        if (prog->fd < 0 && !free_slot)
+        {
+            free_slot = prog;
+        }
+        else if (prog->fd >= 0 && !prog->instances && !idle_slot)
+        {
+            idle_slot = prog;
+        }
+    }
+
+    program_t *prog = free_slot ? free_slot : idle_slot;
+    if (!prog)
+    {
+        return 0;
+    }
+    prog->fd = fd;
+    prog->image = (const uint8_t *)initrd_map(fd, &prog->image_size);
+    prog->text_loaded = 0;
+    prog->instances = 0;
+    prog->lo = prog->hi = 0;
+    return prog;
+}
+
+static void loader_release(process_t *proc)
+{
+    for (int i = 0; i < LOADER_MAX_INSTANCES; i++)
+    {
+        if (instances[i].proc == proc)
+        {
+            instances[i].prog->instances--;
+            instances[i].proc = 0;
+            instances[i].prog = 0;
+            break;
+        }
+    }
+}
+
+int loader_spawn(const char *name, process_t **out)
+{
+    if (!loader_ready)
+    {
+        loader_setup();
+    }
+    if (!syscall_available())
+    {
+        return LOADER_ENOSYS;
+    }
+
+    int fd = initrd_open(name);
+    if (fd < 0)
+    {
+        return LOADER_ENOENT;
+    }
+
+    program_t *prog = find_program(fd);
+    if (!prog)
+    {
+        return LOADER_ENOMEM;
+    }
+    if (!prog->hi)
+    {
+        int rc = parse_image(prog);
+        if (rc < 0)
+        {
+            prog->fd = -1;
+            return rc;
+        }
+    }
+    if (prog->has_writable && prog->instances)
+    {
+        return LOADER_EBUSY;
+    }
+
+    instance_t *slot = 0;
+    for (int i = 0; i < LOADER_MAX_INSTANCES && !slot; i++)
+    {
+        if (!instances[i].proc)
+        {
+            slot = &instances[i];
+        }
+    }
+    if (!slot)
+    {
+        return LOADER_ENOMEM;
+    }
+
+    /* Read-only text is copied once and shared by later launches */
+    if (!prog->text_loaded)
+    {
+        int rc = check_range(prog);
+        if (rc < 0)
+        {
+            return rc;
+        }
+        load_segments(prog, 0);
+        prog->text_loaded = 1;
+    }
+    if (prog->has_writable)
+    {
+        load_segments(prog, 1);
+    }
+
+    process_t *proc = process_create_user(prog->entry, LOADER_STACK_SIZE);
+    if (!proc)
+    {
+        return LOADER_ENOMEM;
+    }
+    proc->on_exit = loader_release;
+    slot->proc = proc;
+    slot->prog = prog;
+    prog->instances++;
+
+    if (out)
+    {
+        *out = proc;
+    }
+    return LOADER_OK;
+}
+
+const char *loader_strerror(int err)
+{
+    switch (err)
+    {
+    case LOADER_OK:
+        return "ok";
+    case LOADER_ENOENT:
+        return "no such file";
+    case LOADER_ENOEXEC:
+        return "not an ELF32 i386 executable";
+    case LOADER_ERANGE:
+        return "load address outside free memory";
+    case LOADER_EBUSY:
+        return "program or its load address is in use";
+    case LOADER_ENOMEM:
+        return "out of program slots, processes or memory";
+    case LOADER_ENOSYS:
+        return "CPU lacks SYSENTER, user mode unavailable";
+    default:
+        return "unknown error";
+    }
+}
@@ -0,0 +1,22 @@
+/* loader.h - ELF32 program loader for initrd images */
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "process.h"
+
+#define LOADER_MAX_PROGRAMS 8
+#define LOADER_MAX_INSTANCES 8
+#define LOADER_STACK_SIZE 4096
+
+#define LOADER_OK 0
+#define LOADER_ENOENT -1  /* no such file in the initrd */
+#define LOADER_ENOEXEC -2 /* not a loadable ELF32 i386 executable */
+#define LOADER_ERANGE -3  /* segments overlap the kernel, modules or RAM end */
+#define LOADER_EBUSY -4   /* load address in use by a running program */
+#define LOADER_ENOMEM -5  /* no program slot, PCB or stack available */
+#define LOADER_ENOSYS -6  /* user mode not supported on this CPU */
+
+int loader_spawn(const char *name, process_t **out);
+const char *loader_strerror(int err);
+
+#endif
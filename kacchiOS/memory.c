@@ -1,8 +1,19 @@
-/* memory.c - Simple heap and stack allocator */
+/* memory.c - Simple heap and stack allocator
+ *
+ * With CONFIG_HEAP_PROFILE each block header also records the request
+ * size, the caller and the owning process, and every allocation and
+ * free updates the counters in heap_profile_t. Without it none of that
+ * code or header space exists.
+ *
+ * heap_lock covers the block list and the profile.
+ */
 #include "memory.h"
 #include "types.h"
+#include "spinlock.h"
+#ifdef CONFIG_HEAP_PROFILE
+#include "process.h"
+#endif
 
-#define HEAP_SIZE (64 * 1024)
 #define ALIGNMENT 16
 
 typedef struct mem_block
@@ -10,10 +21,27 @@ typedef struct mem_block
     uint32_t size;          /* Size of the block payload */
     uint32_t free;          /* 1 if free, 0 if used */
     struct mem_block *next; /* Next block in the free list */
+#ifdef CONFIG_HEAP_PROFILE
+    uint32_t requested;
+    int pid; /* process that allocated it, 0 at boot */
+    uintptr_t caller;
+#endif
 } mem_block_t;
 
-static uint8_t heap_area[HEAP_SIZE];
+#ifdef KACCHI_HOST
+#define HEAP_SECTION
+#else
+/* Kept out of .bss: memory_init writes the only header the heap needs */
+#define HEAP_SECTION __attribute__((section(".noinit")))
+#endif
+
+static uint8_t heap_area[HEAP_SIZE] HEAP_SECTION;
 static mem_block_t *free_list = 0;
+static spinlock_t heap_lock;
+static heap_reclaim_t reclaim = 0;
+#ifdef CONFIG_HEAP_PROFILE
+static heap_profile_t profile;
+#endif
 
 static uint32_t align_up(uint32_t value)
 {
@@ -23,13 +51,44 @@ static uint32_t align_up(uint32_t value)
 
 void memory_init(void)
 {
-    uint32_t base = (uint32_t)heap_area;
-    uint32_t aligned = align_up(base);
-    uint32_t offset = aligned - base;
+    uintptr_t base = (uintptr_t)heap_area;
+    uint32_t offset = align_up((uint32_t)base) - (uint32_t)base;
     free_list = (mem_block_t *)(heap_area + offset);
     free_list->size = HEAP_SIZE - offset - sizeof(mem_block_t);
     free_list->free = 1;
     free_list->next = 0;
+    spin_lock_init(&heap_lock, "heap");
+#ifdef CONFIG_HEAP_PROFILE
+    profile = (heap_profile_t){0};
+#endif
+}
+
+static void free_stats(uint32_t *total_free, uint32_t *largest_block)
+{
+    uint32_t total = 0;
+    uint32_t largest = 0;
+    mem_block_t *cur = free_list;
+    while (cur)
+    {
+        if (cur->free)
+        {
+            total += cur->size;
+            if (cur->size > largest)
+            {
+                largest = cur->size;
+            }
+        }
+        cur = cur->next;
+    }
+    *total_free = total;
+    *largest_block = largest;
+}
+
+static uint32_t fragmentation(void)
+{
+    uint32_t total, largest;
+    free_stats(&total, &largest);
+    return total ? 100 - largest * 100 / total : 0;
 }
 
 static void split_block(mem_block_t *block, uint32_t size)
@@ -46,7 +105,114 @@ static void split_block(mem_block_t *block, uint32_t size)
     }
 }
 
-void *heap_alloc(size_t size)
+#ifdef CONFIG_HEAP_PROFILE
+static uint32_t size_class(uint32_t size)
+{
+    uint32_t cls = 0;
+    while (cls < HEAP_PROFILE_CLASSES - 1 && size > (16u << cls))
+    {
+        cls++;
+    }
+    return cls;
+}
+
+static heap_site_t *find_site(uintptr_t caller)
+{
+    for (int i = 0; i < HEAP_PROFILE_SITES; i++)
+    {
+        heap_site_t *site = &profile.sites[i];
+        if (site->caller == caller)
+        {
+            return site;
+        }
+        if (!site->caller)
+        {
+            site->caller = caller;
+            return site;
+        }
+    }
+    return 0;
+}
+
+static void profile_alloc(mem_block_t *block, uint32_t size, uintptr_t caller)
+{
+    process_t *self = process_current();
+    block->requested = size;
+    block->pid = self ? self->pid : 0;
+    block->caller = caller;
+
+    profile.allocs++;
+    profile.in_use += size;
+    if (profile.in_use > profile.peak)
+    {
+        profile.peak = profile.in_use;
+    }
+    uint32_t cls = size_class(size);
+    profile.class_allocs[cls]++;
+    profile.class_live[cls]++;
+    heap_site_t *site = find_site(caller);
+    if (site)
+    {
+        site->allocs++;
+        site->bytes += size;
+        site->live++;
+        site->live_bytes += size;
+    }
+    else
+    {
+        profile.untracked_allocs++;
+    }
+    uint32_t frag = fragmentation();
+    if (frag > profile.peak_frag_percent)
+    {
+        profile.peak_frag_percent = frag;
+    }
+}
+
+static void profile_free(const mem_block_t *block)
+{
+    profile.frees++;
+    profile.in_use -= block->requested;
+    profile.class_live[size_class(block->requested)]--;
+    for (int i = 0; i < HEAP_PROFILE_SITES && profile.sites[i].caller; i++)
+    {
+        heap_site_t *site = &profile.sites[i];
+        if (site->caller == block->caller)
+        {
+            site->live--;
+            site->live_bytes -= block->requested;
+            break;
+        }
+    }
+}
+
+const heap_profile_t *heap_profile_get(void)
+{
+    return &profile;
+}
+
+void heap_profile_walk(heap_visit_t visit, void *ctx)
+{
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    for (mem_block_t *cur = free_list; cur; cur = cur->next)
+    {
+        if (!cur->free)
+        {
+            visit((uint8_t *)cur + sizeof(mem_block_t), cur->requested, cur->caller, cur->pid,
+                  ctx);
+        }
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+#define CALLER_ARG , (uintptr_t)__builtin_return_address(0)
+#define CALLER_PARAM , uintptr_t caller
+#else
+#define CALLER_ARG
+#define CALLER_PARAM
+#endif
+
+static void *alloc_block(size_t size CALLER_PARAM)
 {
     if (!size)
     {
@@ -54,19 +220,49 @@ void *heap_alloc(size_t size)
     }
 
     uint32_t need = align_up((uint32_t)size);
-    mem_block_t *cur = free_list;
-
-    while (cur)
+    int reclaimed = 0;
+    for (;;)
     {
-        if (cur->free && cur->size >= need)
+        uint32_t flags = spin_lock_irqsave(&heap_lock);
+        mem_block_t *cur = free_list;
+        while (cur)
         {
-            split_block(cur, need);
-            cur->free = 0;
-            return (uint8_t *)cur + sizeof(mem_block_t);
+            if (cur->free && cur->size >= need)
+            {
+                split_block(cur, need);
+                cur->free = 0;
+#ifdef CONFIG_HEAP_PROFILE
+                profile_alloc(cur, (uint32_t)size, caller);
+#endif
+                spin_unlock_irqrestore(&heap_lock, flags);
+                return (uint8_t *)cur + sizeof(mem_block_t);
+            }
+            cur = cur->next;
         }
-        cur = cur->next;
+        int retry = !reclaimed && reclaim;
+#ifdef CONFIG_HEAP_PROFILE
+        if (!retry)
+            profile.failures++;
+#endif
+        spin_unlock_irqrestore(&heap_lock, flags);
+
+        /* Once, outside the lock: let caches hand idle blocks back */
+        if (!retry || !reclaim())
+        {
+            return 0;
+        }
+        reclaimed = 1;
     }
-    return 0;
+}
+
+void heap_set_reclaim(heap_reclaim_t fn)
+{
+    reclaim = fn;
+}
+
+void *heap_alloc(size_t size)
+{
+    return alloc_block(size CALLER_ARG);
 }
 
 static void coalesce(void)
@@ -94,14 +290,19 @@ void heap_free(void *ptr)
         return;
     }
     mem_block_t *block = (mem_block_t *)((uint8_t *)ptr - sizeof(mem_block_t));
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+#ifdef CONFIG_HEAP_PROFILE
+    profile_free(block);
+#endif
     block->free = 1;
     coalesce();
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
 void *stack_alloc(size_t size)
 {
     /* Stack grows downward; we still carve from heap and return base */
-    return heap_alloc(size);
+    return alloc_block(size CALLER_ARG);
 }
 
 void stack_free(void *ptr)
@@ -111,23 +312,20 @@ void stack_free(void *ptr)
 
 void memory_get_stats(uint32_t *total_free, uint32_t *largest_block)
 {
-    uint32_t total = 0;
-    uint32_t largest = 0;
-    mem_block_t *cur = free_list;
-    while (cur)
-    {
-        if (cur->free)
-        {
-            total += cur->size;
-            if (cur->size > largest)
-            {
-                largest = cur->size;
-            }
-        }
-        cur = cur->next;
-    }
+    uint32_t total, largest;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    free_stats(&total, &largest);
+    spin_unlock_irqrestore(&heap_lock, flags);
     if (total_free)
         *total_free = total;
     if (largest_block)
         *largest_block = largest;
 }
+
+uint32_t memory_fragmentation_percent(void)
+{
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    uint32_t frag = fragmentation();
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return frag;
+}
@@ -4,11 +4,61 @@
 
 #include "types.h"
 
+#ifndef HEAP_SIZE
+#define HEAP_SIZE (64 * 1024) /* the hosted build passes a larger one */
+#endif
+
 void memory_init(void);
 void *heap_alloc(size_t size);
 void heap_free(void *ptr);
 void *stack_alloc(size_t size);
 void stack_free(void *ptr);
 void memory_get_stats(uint32_t *total_free, uint32_t *largest_block);
+/* 0 when all free space is one block, approaching 100 as it scatters */
+uint32_t memory_fragmentation_percent(void);
+
+/* Called without the heap lock when an allocation finds no block big
+ * enough; returns nonzero if it freed anything, and the search runs
+ * once more. It may heap_free but must not allocate. */
+typedef uint32_t (*heap_reclaim_t)(void);
+void heap_set_reclaim(heap_reclaim_t fn);
+
+#ifdef CONFIG_HEAP_PROFILE
+/* Built with 'make PROFILE=1'. Size class n counts requests of up to
+ * 16 << n bytes; the last class takes everything larger. */
+#define HEAP_PROFILE_CLASSES 12
+#define HEAP_PROFILE_SITES 32
+
+typedef struct heap_site
+{
+    uintptr_t caller; /* return address of the heap_alloc/stack_alloc call */
+    uint32_t allocs;
+    uint32_t bytes;
+    uint32_t live;
+    uint32_t live_bytes;
+} heap_site_t;
+
+typedef struct heap_profile
+{
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint32_t in_use; /* requested bytes of live allocations */
+    uint32_t peak;
+    uint32_t peak_frag_percent; /* worst fragmentation seen after an allocation */
+    uint32_t class_allocs[HEAP_PROFILE_CLASSES];
+    uint32_t class_live[HEAP_PROFILE_CLASSES];
+    heap_site_t sites[HEAP_PROFILE_SITES];
+    uint32_t untracked_allocs; /* from call sites past the table's end */
+} heap_profile_t;
+
+typedef void (*heap_visit_t)(const void *ptr, uint32_t size, uintptr_t caller, int pid,
+                             void *ctx);
+
+const heap_profile_t *heap_profile_get(void);
+/* Call visit for every live allocation, in address order; visit runs
+ * under the heap lock and must not allocate or free */
+void heap_profile_walk(heap_visit_t visit, void *ctx);
+#endif
 
 #endif
@@ -0,0 +1,69 @@
+/* multiboot.c - Capture what the boot loader handed to kmain */
+#include "multiboot.h"
+
+static const multiboot_info_t *boot_info = 0;
+
+void multiboot_init(uint32_t magic, const multiboot_info_t *mbi)
+{
+    boot_info = (magic == MULTIBOOT_BOOTLOADER_MAGIC) ? mbi : 0;
+}
+
+const char *multiboot_cmdline(void)
+{
+    if (!boot_info || !(boot_info->flags & MULTIBOOT_INFO_CMDLINE) || !boot_info->cmdline)
+    {
+        return "";
+    }
+    return (const char *)boot_info->cmdline;
+}
+
+/* True if word appears as a space-separated token of the command line */
+int multiboot_cmdline_has(const char *word)
+{
+    const char *p = multiboot_cmdline();
+    while (*p)
+    {
+        while (*p == ' ')
+            p++;
+        const char *w = word;
+        while (*w && *p == *w)
+        {
+            p++;
+            w++;
+        }
+        if (!*w && (*p == ' ' || !*p))
+        {
+            return 1;
+        }
+        while (*p && *p != ' ')
+            p++;
+    }
+    return 0;
+}
+
+uint32_t multiboot_mem_upper_kb(void)
+{
+    if (!boot_info || !(boot_info->flags & MULTIBOOT_INFO_MEMORY))
+    {
+        return 0;
+    }
+    return boot_info->mem_upper;
+}
+
+int multiboot_module_count(void)
+{
+    if (!boot_info || !(boot_info->flags & MULTIBOOT_INFO_MODS))
+    {
+        return 0;
+    }
+    return (int)boot_info->mods_count;
+}
+
+const multiboot_module_t *multiboot_get_module(int idx)
+{
+    if (idx < 0 || idx >= multiboot_module_count())
+    {
+        return 0;
+    }
+    return (const multiboot_module_t *)boot_info->mods_addr + idx;
+}
@@ -0,0 +1,42 @@
+/* multiboot.h - Multiboot (v1) boot information */
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include "types.h"
+
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+#define MULTIBOOT_INFO_MEMORY 0x00000001
+#define MULTIBOOT_INFO_CMDLINE 0x00000004
+#define MULTIBOOT_INFO_MODS 0x00000008
+
+typedef struct multiboot_info
+{
+    uint32_t flags;
+    uint32_t mem_lower; /* KB below 1 MB */
+    uint32_t mem_upper; /* KB above 1 MB */
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+} multiboot_info_t;
+
+typedef struct multiboot_module
+{
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t string; /* module command line */
+    uint32_t reserved;
+} multiboot_module_t;
+
+void multiboot_init(uint32_t magic, const multiboot_info_t *mbi);
+const char *multiboot_cmdline(void);
+int multiboot_cmdline_has(const char *word);
+uint32_t multiboot_mem_upper_kb(void);
+int multiboot_module_count(void);
+const multiboot_module_t *multiboot_get_module(int idx);
+
+#endif
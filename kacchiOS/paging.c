@@ -0,0 +1,381 @@
+/* paging.c - Page directories, private regions and copy-on-write faults
+ *
+ * The kernel directory identity maps RAM with 4 MB pages (user
+ * accessible, as before paging, so ring 3 programs keep running at their
+ * physical link addresses). A process directory copies those entries and
+ * adds page tables for its private region. Cloning marks every private
+ * page read-only with PTE_COW in both directories and takes a frame
+ * reference; the first write from either side faults and either copies
+ * the frame or, if it is the last holder, just makes it writable again.
+ * CR0.WP is set so kernel-mode writes take the same faults.
+ */
+#include "paging.h"
+#include "pmm.h"
+#include "multiboot.h"
+#include "string.h"
+
+#define DIR_ENTRIES 1024
+#define LARGE_PAGE 0x400000u
+#define PF_PRESENT 0x1 /* page fault error code: protection, not missing */
+#define PF_WRITE 0x2
+
+uint32_t vm_kernel_dir = 0;
+static uint32_t identity_end; /* first address past the 4 MB identity map */
+static vm_stats_t stats;
+
+static uint32_t *table_of(uint32_t entry)
+{
+    return (uint32_t *)(entry & PTE_FRAME);
+}
+
+int paging_init(void)
+{
+    if (pmm_init() < 0)
+    {
+        return -1;
+    }
+    uint32_t dir = pmm_alloc();
+    if (!dir)
+    {
+        return -1;
+    }
+
+    /* Everything up to the top of RAM, capped below the private region */
+    uint32_t top = 0x100000 + multiboot_mem_upper_kb() * 1024;
+    uint32_t identity = (top + LARGE_PAGE - 1) / LARGE_PAGE;
+    if (identity > VM_PRIVATE_BASE / LARGE_PAGE)
+    {
+        identity = VM_PRIVATE_BASE / LARGE_PAGE;
+    }
+    uint32_t *entries = (uint32_t *)dir;
+    for (uint32_t i = 0; i < identity; i++)
+    {
+        entries[i] = i * LARGE_PAGE | PTE_LARGE | PTE_USER | PTE_WRITE | PTE_PRESENT;
+    }
+
+    vm_kernel_dir = dir;
+    identity_end = identity * LARGE_PAGE;
+    this_cpu->page_dir = dir;
+    write_cr4(read_cr4() | CR4_PSE);
+    write_cr3(dir);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+    return 0;
+}
+
+/* The process's directory, created from the kernel's on first use */
+static uint32_t *dir_of(process_t *proc)
+{
+    if (!proc->page_dir)
+    {
+        if (!vm_kernel_dir)
+        {
+            return 0;
+        }
+        uint32_t dir = pmm_alloc();
+        if (!dir)
+        {
+            return 0;
+        }
+        memcpy((void *)dir, (void *)vm_kernel_dir, PAGE_SIZE);
+        proc->page_dir = dir;
+        proc->vm_next = VM_PRIVATE_BASE;
+        if (proc == process_current())
+        {
+            vm_switch(proc);
+        }
+    }
+    return (uint32_t *)proc->page_dir;
+}
+
+/* Page table entry for addr, allocating the table if asked */
+static uint32_t *pte_of(uint32_t *dir, uint32_t addr, int create)
+{
+    uint32_t *pde = &dir[addr >> 22];
+    if (!(*pde & PTE_PRESENT))
+    {
+        if (!create)
+        {
+            return 0;
+        }
+        uint32_t table = pmm_alloc();
+        if (!table)
+        {
+            return 0;
+        }
+        *pde = table | PTE_USER | PTE_WRITE | PTE_PRESENT;
+    }
+    return &table_of(*pde)[(addr >> 12) & (DIR_ENTRIES - 1)];
+}
+
+static void unmap_range(uint32_t *dir, uint32_t addr, uint32_t pages)
+{
+    for (uint32_t i = 0; i < pages; i++, addr += PAGE_SIZE)
+    {
+        uint32_t *pte = pte_of(dir, addr, 0);
+        if (pte && (*pte & PTE_PRESENT))
+        {
+            pmm_put(*pte & PTE_FRAME);
+            *pte = 0;
+            invlpg(addr);
+        }
+    }
+}
+
+/* Reserve pages of address space in proc's private region */
+static uint32_t reserve(process_t *proc, uint32_t pages)
+{
+    uint32_t addr = proc->vm_next;
+    if (!pages || pages > (VM_PRIVATE_END - addr) / PAGE_SIZE)
+    {
+        return 0;
+    }
+    proc->vm_next = addr + pages * PAGE_SIZE;
+    return addr;
+}
+
+/* Map pages at addr; frames[i] if given (shared), fresh frames if not */
+static void *map_pages(const uint32_t *frames, uint32_t pages)
+{
+    process_t *self = process_current();
+    uint32_t *dir = self ? dir_of(self) : 0;
+    uint32_t addr = dir ? reserve(self, pages) : 0;
+    if (!addr)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < pages; i++)
+    {
+        uint32_t va = addr + i * PAGE_SIZE;
+        uint32_t *pte = pte_of(dir, va, 1);
+        uint32_t frame = 0;
+        uint32_t flags = PTE_USER | PTE_WRITE | PTE_PRESENT;
+        if (pte && frames)
+        {
+            frame = frames[i];
+            pmm_get(frame);
+            flags |= PTE_SHARED;
+        }
+        else if (pte)
+        {
+            frame = pmm_alloc();
+        }
+        if (!frame)
+        {
+            unmap_range(dir, addr, i);
+            if (self->vm_next == addr + pages * PAGE_SIZE)
+            {
+                self->vm_next = addr; /* nothing was mapped after us */
+            }
+            return 0;
+        }
+        *pte = frame | flags;
+    }
+    return (void *)addr;
+}
+
+void *vm_alloc(size_t bytes)
+{
+    return map_pages(0, (uint32_t)((bytes + PAGE_SIZE - 1) / PAGE_SIZE));
+}
+
+void *vm_map_shared(const uint32_t *frames, uint32_t count)
+{
+    return frames ? map_pages(frames, count) : 0;
+}
+
+int vm_clone(process_t *parent, process_t *child)
+{
+    if (!parent || !parent->page_dir)
+    {
+        return 0; /* no private memory to share */
+    }
+    uint32_t *pdir = (uint32_t *)parent->page_dir;
+    uint32_t *cdir = dir_of(child);
+    if (!cdir)
+    {
+        return -1;
+    }
+
+    for (uint32_t d = VM_PRIVATE_BASE >> 22; d < VM_PRIVATE_END >> 22; d++)
+    {
+        if (!(pdir[d] & PTE_PRESENT))
+        {
+            continue;
+        }
+        uint32_t table = pmm_alloc();
+        if (!table)
+        {
+            vm_release(child);
+            return -1;
+        }
+        cdir[d] = table | (pdir[d] & ~PTE_FRAME);
+
+        uint32_t *src = table_of(pdir[d]);
+        uint32_t *dst = (uint32_t *)table;
+        for (uint32_t i = 0; i < DIR_ENTRIES; i++)
+        {
+            uint32_t pte = src[i];
+            if (!(pte & PTE_PRESENT))
+            {
+                continue;
+            }
+            if (!(pte & PTE_SHARED))
+            {
+                if (pte & PTE_WRITE)
+                {
+                    stats.pages_shared++;
+                }
+                pte = (pte & ~PTE_WRITE) | PTE_COW;
+                src[i] = pte;
+            }
+            pmm_get(pte & PTE_FRAME);
+            dst[i] = pte;
+        }
+    }
+    child->vm_next = parent->vm_next;
+    stats.clones++;
+
+    /* The parent's writable entries just turned read-only */
+    if (parent == process_current())
+    {
+        write_cr3(parent->page_dir);
+    }
+    return 0;
+}
+
+void vm_release(process_t *proc)
+{
+    if (!proc || !proc->page_dir)
+    {
+        return;
+    }
+    uint32_t *dir = (uint32_t *)proc->page_dir;
+    if (this_cpu->page_dir == proc->page_dir)
+    {
+        this_cpu->page_dir = vm_kernel_dir;
+        write_cr3(vm_kernel_dir);
+    }
+
+    for (uint32_t d = VM_PRIVATE_BASE >> 22; d < VM_PRIVATE_END >> 22; d++)
+    {
+        if (!(dir[d] & PTE_PRESENT))
+        {
+            continue;
+        }
+        uint32_t *table = table_of(dir[d]);
+        for (uint32_t i = 0; i < DIR_ENTRIES; i++)
+        {
+            if (table[i] & PTE_PRESENT)
+            {
+                pmm_put(table[i] & PTE_FRAME);
+            }
+        }
+        pmm_put(dir[d] & PTE_FRAME);
+    }
+    pmm_put(proc->page_dir);
+    proc->page_dir = 0;
+    proc->vm_next = 0;
+}
+
+int vm_handle_fault(uint32_t addr, uint32_t error)
+{
+    process_t *self = process_current();
+    if (!self || !self->page_dir || addr < VM_PRIVATE_BASE || addr >= VM_PRIVATE_END ||
+        (error & (PF_PRESENT | PF_WRITE)) != (PF_PRESENT | PF_WRITE))
+    {
+        return -1;
+    }
+    uint32_t *pte = pte_of((uint32_t *)self->page_dir, addr, 0);
+    if (!pte || !(*pte & PTE_COW))
+    {
+        return -1;
+    }
+
+    stats.cow_faults++;
+    uint32_t frame = *pte & PTE_FRAME;
+    uint32_t flags = (*pte & ~(PTE_FRAME | PTE_COW)) | PTE_WRITE;
+    if (pmm_refcount(frame) == 1)
+    {
+        stats.cow_reuses++; /* every other holder already copied or exited */
+    }
+    else
+    {
+        uint32_t copy = pmm_alloc();
+        if (!copy)
+        {
+            return -1;
+        }
+        frame_copy(copy, frame);
+        pmm_put(frame);
+        frame = copy;
+        stats.cow_copies++;
+    }
+    *pte = frame | flags;
+    invlpg(addr);
+    return 0;
+}
+
+int vm_user_ok(uint32_t addr, uint32_t len, int write)
+{
+    if (!vm_kernel_dir)
+    {
+        return 1; /* no paging: every address reads something */
+    }
+    if (len > 0xFFFFFFFFu - addr)
+    {
+        return 0;
+    }
+    uint32_t end = addr + len;
+    if (end <= identity_end)
+    {
+        return 1;
+    }
+
+    process_t *self = process_current();
+    if (!self || !self->page_dir || addr < VM_PRIVATE_BASE || end > VM_PRIVATE_END)
+    {
+        return 0;
+    }
+    uint32_t *dir = (uint32_t *)self->page_dir;
+    for (uint32_t page = addr & PTE_FRAME; page < end; page += PAGE_SIZE)
+    {
+        uint32_t *pte = pte_of(dir, page, 0);
+        if (!pte || !(*pte & PTE_PRESENT) || (write && !(*pte & (PTE_WRITE | PTE_COW))))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint32_t vm_private_pages(const process_t *proc)
+{
+    if (!proc || !proc->page_dir)
+    {
+        return 0;
+    }
+    const uint32_t *dir = (const uint32_t *)proc->page_dir;
+    uint32_t pages = 0;
+    for (uint32_t d = VM_PRIVATE_BASE >> 22; d < VM_PRIVATE_END >> 22; d++)
+    {
+        if (!(dir[d] & PTE_PRESENT))
+        {
+            continue;
+        }
+        const uint32_t *table = table_of(dir[d]);
+        for (uint32_t i = 0; i < DIR_ENTRIES; i++)
+        {
+            if (table[i] & PTE_PRESENT)
+            {
+                pages++;
+            }
+        }
+    }
+    return pages;
+}
+
+void vm_get_stats(vm_stats_t *out)
+{
+    *out = stats;
+}
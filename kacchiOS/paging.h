@@ -0,0 +1,76 @@
+/* paging.h - Paging, per-process private memory and copy-on-write
+ *
+ * Physical memory is identity mapped with 4 MB pages in every page
+ * directory, so kernel pointers mean the same thing in each process.
+ * Above that, [VM_PRIVATE_BASE, VM_PRIVATE_END) is per process and
+ * mapped with 4 KB pages: private pages from vm_alloc(), pages shared
+ * copy-on-write by process_clone(), and shared memory segments (shm.h).
+ * A process gets its own directory the first time it needs one.
+ */
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "types.h"
+#include "cpu.h"
+#include "percpu.h"
+#include "process.h"
+
+#define VM_PRIVATE_BASE 0x80000000u
+#define VM_PRIVATE_END 0x90000000u
+
+#define PTE_PRESENT 0x001
+#define PTE_WRITE 0x002
+#define PTE_USER 0x004
+#define PTE_LARGE 0x080  /* 4 MB page in a directory entry */
+#define PTE_COW 0x200    /* software bit: read-only until the next write fault */
+#define PTE_SHARED 0x400 /* software bit: shm page, never copied */
+#define PTE_FRAME 0xFFFFF000u
+
+typedef struct vm_stats
+{
+    uint32_t clones;
+    uint32_t pages_shared; /* private pages made copy-on-write by clones */
+    uint32_t cow_faults;
+    uint32_t cow_copies; /* faults that copied a frame */
+    uint32_t cow_reuses; /* faults on a frame nobody else held any more */
+} vm_stats_t;
+
+int paging_init(void);
+
+/* Map zeroed private pages into the current process; 0 on failure */
+void *vm_alloc(size_t bytes);
+/* Map frames (held by the caller) shared and writable into the current
+ * process; takes a reference on each. 0 on failure */
+void *vm_map_shared(const uint32_t *frames, uint32_t count);
+/* Give child the parent's private mappings, copy-on-write */
+int vm_clone(process_t *parent, process_t *child);
+/* Drop every private mapping and the process's page directory */
+void vm_release(process_t *proc);
+/* Resolve a page fault; 0 if the faulting access can be retried */
+int vm_handle_fault(uint32_t addr, uint32_t error);
+/* 1 if the kernel can touch [addr, addr + len) for the current process
+ * without an unresolvable fault: identity-mapped RAM, or present pages
+ * of its private region (writable or copy-on-write if write) */
+int vm_user_ok(uint32_t addr, uint32_t len, int write);
+/* Pages currently mapped in proc's private region */
+uint32_t vm_private_pages(const process_t *proc);
+void vm_get_stats(vm_stats_t *out);
+
+extern uint32_t vm_kernel_dir; /* physical address of the shared directory */
+
+/* Load next's page directory if it differs from the one in CR3 */
+static inline void vm_switch(const process_t *next)
+{
+#ifdef KACCHI_HOST
+    (void)next;
+#else
+    uint32_t dir = next->page_dir ? next->page_dir : vm_kernel_dir;
+    if (dir && dir != this_cpu->page_dir)
+    {
+        this_cpu->page_dir = dir;
+        write_cr3(dir);
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,60 @@
+/* pci.c - PCI configuration space access (mechanism #1) */
+#include "pci.h"
+#include "io.h"
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+
+static uint32_t config_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
+{
+    return 0x80000000u | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) |
+           ((uint32_t)func << 8) | (offset & 0xFC);
+}
+
+uint32_t pci_config_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
+{
+    outl(PCI_CONFIG_ADDRESS, config_address(bus, slot, func, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+void pci_config_write(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value)
+{
+    outl(PCI_CONFIG_ADDRESS, config_address(bus, slot, func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+int pci_find_class(uint8_t class_code, uint8_t subclass, pci_device_t *out)
+{
+    /* Brute-force scan; QEMU's i440FX/PIIX machine only populates bus 0 */
+    for (int bus = 0; bus < 256; bus++)
+    {
+        for (int slot = 0; slot < 32; slot++)
+        {
+            for (int func = 0; func < 8; func++)
+            {
+                uint32_t id = pci_config_read(bus, slot, func, 0x00);
+                if ((id & 0xFFFF) == 0xFFFF)
+                {
+                    if (func == 0)
+                        break;
+                    continue;
+                }
+                uint32_t class_reg = pci_config_read(bus, slot, func, 0x08);
+                if (((class_reg >> 24) & 0xFF) == class_code &&
+                    ((class_reg >> 16) & 0xFF) == subclass)
+                {
+                    if (out)
+                    {
+                        out->bus = bus;
+                        out->slot = slot;
+                        out->func = func;
+                        out->vendor = id & 0xFFFF;
+                        out->device = id >> 16;
+                    }
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+/* pci.h - PCI configuration space access */
+#ifndef PCI_H
+#define PCI_H
+
+#include "types.h"
+
+typedef struct pci_device
+{
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+    uint16_t vendor;
+    uint16_t device;
+} pci_device_t;
+
+uint32_t pci_config_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
+void pci_config_write(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value);
+int pci_find_class(uint8_t class_code, uint8_t subclass, pci_device_t *out);
+
+#endif
@@ -0,0 +1,28 @@
+/* percpu.c - Per-CPU areas and the event trace ring */
+#include "percpu.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "process.h"
+
+percpu_t percpu_area[PERCPU_MAX_CPUS];
+
+void percpu_init(uint32_t cpu_id)
+{
+    percpu_t *area = &percpu_area[cpu_id];
+    area->self = area;
+    area->cpu_id = cpu_id;
+#ifndef KACCHI_HOST
+    gdt_set_percpu(area, sizeof(percpu_t));
+#endif
+}
+
+void percpu_trace_record(uint16_t event, uint32_t arg)
+{
+    percpu_t *cpu = this_cpu->self;
+    trace_entry_t *e = &cpu->trace[cpu->trace_next & (PERCPU_TRACE_SIZE - 1)];
+    e->tsc_low = (uint32_t)rdtsc();
+    e->event = event;
+    e->pid = cpu->current ? (uint16_t)cpu->current->pid : 0;
+    e->arg = arg;
+    cpu->trace_next++;
+}
@@ -0,0 +1,89 @@
+/* percpu.h - Per-CPU data reached through the %gs segment
+ *
+ * Each CPU's GDT_PERCPU descriptor has its base at that CPU's percpu_t,
+ * so this_cpu->field compiles to a single %gs-relative load or store
+ * and counters update with one read-modify-write instruction, which no
+ * interrupt on the same CPU can split. The hosted build has no segment
+ * and uses percpu_area[0] directly.
+ */
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include "types.h"
+
+#define PERCPU_MAX_CPUS 1
+#define PERCPU_TRACE_SIZE 64 /* power of two */
+
+struct process;
+struct runqueue;
+struct work;
+
+typedef struct percpu_stats
+{
+    uint32_t context_switches;
+    uint32_t yields;
+    uint32_t blocks;
+    uint32_t wakeups;
+    uint32_t ipc_sends;
+    uint32_t ipc_recvs;
+    uint32_t syscalls;
+    uint32_t irqs;
+    uint32_t work_queued;
+    uint32_t work_coalesced; /* queued again while still pending */
+    uint32_t work_run;
+    uint32_t softirq_passes;
+} percpu_stats_t;
+
+#define TRACE_SWITCH 1  /* arg: pid switched to */
+#define TRACE_BLOCK 2   /* arg: pid blocking */
+#define TRACE_WAKE 3    /* arg: pid made ready */
+#define TRACE_SYSCALL 4 /* arg: call number */
+
+typedef struct trace_entry
+{
+    uint32_t tsc_low;
+    uint16_t event;
+    uint16_t pid; /* process running when the event was recorded */
+    uint32_t arg;
+} trace_entry_t;
+
+typedef struct percpu
+{
+    struct percpu *self; /* flat address of this area */
+    uint32_t cpu_id;
+    struct process *current;
+    struct runqueue *rq;
+    uint32_t page_dir; /* physical address loaded in CR3 */
+    struct work *softirq_head; /* bottom halves run at scheduling points */
+    struct work *softirq_tail;
+    struct work *thread_head; /* bottom halves run by the kworker process */
+    struct work *thread_tail;
+    percpu_stats_t stats;
+    uint32_t trace_on;
+    uint32_t trace_next;
+    trace_entry_t trace[PERCPU_TRACE_SIZE];
+} percpu_t;
+
+extern percpu_t percpu_area[PERCPU_MAX_CPUS];
+
+#ifdef KACCHI_HOST
+#define this_cpu (&percpu_area[0])
+#else
+#define this_cpu ((__seg_gs percpu_t *)0)
+#endif
+
+#define percpu_inc(counter) (this_cpu->stats.counter++)
+
+void percpu_init(uint32_t cpu_id);
+void percpu_trace_record(uint16_t event, uint32_t arg);
+
+/* Costs one load and a branch while tracing is off */
+static inline void percpu_trace(uint16_t event, uint32_t arg)
+{
+    if (this_cpu->trace_on)
+    {
+        percpu_trace_record(event, arg);
+    }
+}
+
+#endif
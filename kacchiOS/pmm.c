@@ -0,0 +1,135 @@
+/* pmm.c - Physical page frame allocator
+ *
+ * Manages RAM from PMM_BASE (or the end of the boot modules, if higher)
+ * to the top of memory reported by multiboot. Every frame has a 16-bit
+ * reference count so page tables can share frames copy-on-write; a
+ * count of zero means free. The count array lives in the first frames
+ * of the pool itself. Frames are identity mapped, so the kernel reads
+ * and writes them through their physical address.
+ */
+#include "pmm.h"
+#include "multiboot.h"
+#include "string.h"
+
+extern uint8_t __kernel_end[];
+
+static uint16_t *refcounts = 0;
+static uint32_t pool_base = 0; /* physical address of frame 0 */
+static uint32_t pool_frames = 0;
+static uint32_t free_frames = 0;
+static uint32_t next_hint = 0; /* where the next search starts */
+
+static uint32_t align_up(uint32_t v)
+{
+    return (v + PAGE_SIZE - 1) & ~(uint32_t)(PAGE_SIZE - 1);
+}
+
+int pmm_init(void)
+{
+    uint32_t base = PMM_BASE;
+    if ((uint32_t)__kernel_end > base)
+    {
+        base = (uint32_t)__kernel_end;
+    }
+    for (int i = 0; i < multiboot_module_count(); i++)
+    {
+        const multiboot_module_t *mod = multiboot_get_module(i);
+        if (mod->mod_end > base)
+        {
+            base = mod->mod_end;
+        }
+    }
+    base = align_up(base);
+
+    uint32_t top = 0x100000 + multiboot_mem_upper_kb() * 1024;
+    if (top <= base + 2 * PAGE_SIZE)
+    {
+        return -1; /* nothing above the kernel's own area */
+    }
+
+    uint32_t frames = (top - base) / PAGE_SIZE;
+    uint32_t meta = align_up(frames * sizeof(uint16_t)) / PAGE_SIZE;
+    refcounts = (uint16_t *)base;
+    pool_base = base + meta * PAGE_SIZE;
+    pool_frames = frames - meta;
+    free_frames = pool_frames;
+    next_hint = 0;
+    memset(refcounts, 0, pool_frames * sizeof(uint16_t));
+    return 0;
+}
+
+static uint32_t index_of(uint32_t frame)
+{
+    return (frame - pool_base) / PAGE_SIZE;
+}
+
+static int in_pool(uint32_t frame)
+{
+    return frame >= pool_base && index_of(frame) < pool_frames;
+}
+
+uint32_t pmm_alloc(void)
+{
+    if (!free_frames)
+    {
+        return 0;
+    }
+    for (uint32_t n = 0; n < pool_frames; n++)
+    {
+        uint32_t i = next_hint + n;
+        if (i >= pool_frames)
+        {
+            i -= pool_frames;
+        }
+        if (!refcounts[i])
+        {
+            refcounts[i] = 1;
+            free_frames--;
+            next_hint = i + 1 < pool_frames ? i + 1 : 0;
+            uint32_t frame = pool_base + i * PAGE_SIZE;
+            frame_zero(frame);
+            return frame;
+        }
+    }
+    return 0;
+}
+
+void pmm_get(uint32_t frame)
+{
+    if (in_pool(frame))
+    {
+        refcounts[index_of(frame)]++;
+    }
+}
+
+void pmm_put(uint32_t frame)
+{
+    if (!in_pool(frame))
+    {
+        return;
+    }
+    uint32_t i = index_of(frame);
+    if (refcounts[i] && --refcounts[i] == 0)
+    {
+        free_frames++;
+        if (i < next_hint)
+        {
+            next_hint = i; /* keep allocations packed low */
+        }
+    }
+}
+
+uint32_t pmm_refcount(uint32_t frame)
+{
+    return in_pool(frame) ? refcounts[index_of(frame)] : 0;
+}
+
+uint32_t pmm_total_frames(void)
+{
+    return pool_frames;
+}
+
+uint32_t pmm_free_frames(void)
+{
+    return free_frames;
+}
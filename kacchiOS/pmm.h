@@ -0,0 +1,38 @@
+/* pmm.h - Physical page frame allocator with reference counts */
+#ifndef PMM_H
+#define PMM_H
+
+#include "types.h"
+
+#define PAGE_SIZE 4096
+
+/* Frames below this belong to the kernel image, the heap, boot modules
+ * and ring 3 programs, which run at their physical link addresses */
+#define PMM_BASE 0x01000000
+
+int pmm_init(void);
+/* A zero-filled frame with one reference, or 0 when memory is exhausted */
+uint32_t pmm_alloc(void);
+void pmm_get(uint32_t frame);
+/* Drop a reference; the frame is free again when the last one goes */
+void pmm_put(uint32_t frame);
+uint32_t pmm_refcount(uint32_t frame);
+uint32_t pmm_total_frames(void);
+uint32_t pmm_free_frames(void);
+
+/* Whole-frame copy and clear with rep movsl/stosl. These run inside the
+ * page fault handler, which does not save the XMM registers that the
+ * faulting code may be halfway through using in an SSE2 memcpy/memset. */
+static inline void frame_copy(uint32_t dst, uint32_t src)
+{
+    uint32_t d = dst, s = src, n = PAGE_SIZE / 4;
+    __asm__ volatile("cld; rep movsl" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+}
+
+static inline void frame_zero(uint32_t frame)
+{
+    uint32_t d = frame, n = PAGE_SIZE / 4;
+    __asm__ volatile("cld; rep stosl" : "+D"(d), "+c"(n) : "a"(0) : "memory");
+}
+
+#endif
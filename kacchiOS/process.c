@@ -2,12 +2,30 @@
 #include "process.h"
 #include "memory.h"
 #include "scheduler.h"
+#include "syscall.h"
+#include "paging.h"
+#include "spinlock.h"
+#include "string.h"
 
-#define MAX_PROCESSES 8
+#define MAX_PROCESSES 16
 #define DEFAULT_STACK_SIZE 4096
+#define STACK_PAINT 0xA5 /* fill byte; untouched stack still holds it */
+#define MAX_STACK_PROFILES 16
+#define STACK_MIN_HEADROOM 256
 
 static process_t process_table[MAX_PROCESSES];
 static int next_pid = 1;
+/* Slot claims and the stack profiles; the table is mostly read */
+static rwlock_t table_lock;
+
+/* Deepest stack use seen per entry point, kept after the processes exit */
+typedef struct stack_profile
+{
+    process_entry_t entry;
+    size_t peak;
+} stack_profile_t;
+
+static stack_profile_t stack_profiles[MAX_STACK_PROFILES];
 
 static process_t *alloc_pcb(void)
 {
@@ -21,11 +39,6 @@ static process_t *alloc_pcb(void)
     return 0;
 }
 
-process_t *process_current(void)
-{
-    return scheduler_current();
-}
-
 static void process_bootstrap(process_t *proc)
 {
     proc->entry(proc->arg);
@@ -35,39 +48,49 @@ static void process_bootstrap(process_t *proc)
 static void setup_context(process_t *proc)
 {
     uint8_t *top = proc->stack_base + proc->stack_size;
-    uint32_t *sp = (uint32_t *)top;
+    uintptr_t *sp = (uintptr_t *)top;
 
+#ifdef KACCHI_HOST
+    *(--sp) = 0; /* keep the x86-64 ABI's 16-byte alignment at entry */
+#endif
     /* Set up initial stack for process_bootstrap(proc) */
-    *(--sp) = (uint32_t)proc; /* Argument for bootstrap */
-    *(--sp) = 0;              /* Fake return address */
+    *(--sp) = (uintptr_t)proc; /* Argument for bootstrap */
+    *(--sp) = 0;               /* Fake return address */
 
-    proc->ctx.esp = (uint32_t)sp;
-    proc->ctx.ebp = (uint32_t)sp;
-    proc->ctx.eip = (uint32_t)process_bootstrap;
+    proc->ctx.esp = (uintptr_t)sp;
+    proc->ctx.ebp = (uintptr_t)sp;
+    proc->ctx.eip = (uintptr_t)process_bootstrap;
 }
 
-process_t *process_create(process_entry_t entry, void *arg, size_t stack_size)
+static process_t *create_common(process_entry_t entry, void *arg, size_t stack_size)
 {
     if (!entry)
     {
         return 0;
     }
 
-    process_t *proc = alloc_pcb();
-    if (!proc)
+    /* Stack first: the heap has its own lock, taken outside ours */
+    size_t need = stack_size ? stack_size : DEFAULT_STACK_SIZE;
+    uint8_t *stack = (uint8_t *)stack_alloc(need);
+    if (!stack)
     {
         return 0;
     }
 
-    size_t need = stack_size ? stack_size : DEFAULT_STACK_SIZE;
-    uint8_t *stack = (uint8_t *)stack_alloc(need);
-    if (!stack)
+    uint32_t flags = write_lock_irqsave(&table_lock);
+    process_t *proc = alloc_pcb();
+    if (proc)
+    {
+        proc->pid = next_pid++;
+        proc->state = PROC_READY;
+    }
+    write_unlock_irqrestore(&table_lock, flags);
+    if (!proc)
     {
+        stack_free(stack);
         return 0;
     }
 
-    proc->pid = next_pid++;
-    proc->state = PROC_READY;
     proc->stack_base = stack;
     proc->stack_size = need;
     proc->entry = entry;
@@ -75,8 +98,169 @@ process_t *process_create(process_entry_t entry, void *arg, size_t stack_size)
     proc->next = 0;
     proc->age = 0;
     proc->time_slice = 0;
+    proc->user_stack = 0;
+    proc->user_stack_size = 0;
+    proc->user_entry = 0;
+    proc->on_exit = 0;
+    proc->fibers = 0;
+    proc->sched_class = SCHED_NORMAL;
+    proc->dl_next = 0;
+    proc->page_dir = 0;
+    proc->vm_next = 0;
+    arena_init(&proc->arena, 0);
+    proc->run_cycles = 0;
 
+    memset(stack, STACK_PAINT, need);
     setup_context(proc);
+    return proc;
+}
+
+size_t process_stack_peak(const process_t *proc)
+{
+    if (!proc || !proc->stack_base)
+    {
+        return 0;
+    }
+
+    /* Stacks grow down, so the lowest overwritten byte marks the peak */
+    const uint32_t *word = (const uint32_t *)proc->stack_base;
+    const uint32_t *end = (const uint32_t *)(proc->stack_base + proc->stack_size);
+    const uint32_t paint = STACK_PAINT * 0x01010101u;
+    while (word < end && *word == paint)
+    {
+        word++;
+    }
+    return (size_t)((const uint8_t *)end - (const uint8_t *)word);
+}
+
+static void record_stack_profile(const process_t *proc)
+{
+    size_t peak = process_stack_peak(proc);
+    uint32_t flags = write_lock_irqsave(&table_lock);
+    stack_profile_t *slot = 0;
+    for (int i = 0; i < MAX_STACK_PROFILES; i++)
+    {
+        if (stack_profiles[i].entry == proc->entry)
+        {
+            slot = &stack_profiles[i];
+            break;
+        }
+        if (!slot && !stack_profiles[i].entry)
+        {
+            slot = &stack_profiles[i];
+        }
+    }
+    /* No slot means the table is full: this entry point goes unprofiled */
+    if (slot)
+    {
+        slot->entry = proc->entry;
+        if (peak > slot->peak)
+        {
+            slot->peak = peak;
+        }
+    }
+    write_unlock_irqrestore(&table_lock, flags);
+}
+
+size_t process_stack_recommend(process_entry_t entry, size_t fallback)
+{
+    size_t peak = 0;
+    uint32_t flags = read_lock_irqsave(&table_lock);
+    for (int i = 0; i < MAX_STACK_PROFILES; i++)
+    {
+        if (stack_profiles[i].entry == entry)
+        {
+            peak = stack_profiles[i].peak;
+        }
+    }
+    /* Processes still running may have gone deeper than the last exit */
+    for (int i = 0; i < MAX_PROCESSES; i++)
+    {
+        process_t *p = &process_table[i];
+        if (p->entry == entry && p->stack_base &&
+            (p->state == PROC_READY || p->state == PROC_CURRENT || p->state == PROC_BLOCKED))
+        {
+            size_t live = process_stack_peak(p);
+            if (live > peak)
+                peak = live;
+        }
+    }
+    read_unlock_irqrestore(&table_lock, flags);
+    if (!peak)
+    {
+        return fallback;
+    }
+
+    /* Half again as much as measured, but never less than the minimum headroom */
+    size_t headroom = peak / 2 > STACK_MIN_HEADROOM ? peak / 2 : STACK_MIN_HEADROOM;
+    size_t size = (peak + headroom + 15) & ~(size_t)15;
+    return size < fallback ? size : fallback;
+}
+
+process_t *process_create(process_entry_t entry, void *arg, size_t stack_size)
+{
+    process_t *proc = create_common(entry, arg, stack_size);
+    if (proc)
+    {
+        scheduler_add(proc);
+    }
+    return proc;
+}
+
+process_t *process_clone(process_entry_t entry, void *arg, size_t stack_size)
+{
+    process_t *proc = create_common(entry, arg, stack_size);
+    if (!proc)
+    {
+        return 0;
+    }
+    if (vm_clone(process_current(), proc) < 0)
+    {
+        stack_free(proc->stack_base);
+        proc->stack_base = 0;
+        proc->state = PROC_UNUSED;
+        return 0;
+    }
+    scheduler_add(proc);
+    return proc;
+}
+
+/* Runs on the new process's kernel stack, then drops to ring 3 for good */
+static void enter_user(void *arg)
+{
+    (void)arg;
+    process_t *self = process_current();
+    uint32_t *sp = (uint32_t *)(self->user_stack + self->user_stack_size);
+    *(--sp) = 0; /* fake return address; user code must exit via SYS_EXIT */
+    user_mode_enter(self->user_entry, (uintptr_t)sp);
+}
+
+process_t *process_create_user(uint32_t entry, size_t user_stack_size)
+{
+    if (!entry || !syscall_available())
+    {
+        return 0;
+    }
+
+    /* The PCB's own stack becomes the kernel stack used by SYSENTER */
+    process_t *proc = create_common(enter_user, 0, DEFAULT_STACK_SIZE);
+    if (!proc)
+    {
+        return 0;
+    }
+
+    size_t need = user_stack_size ? user_stack_size : DEFAULT_STACK_SIZE;
+    proc->user_stack = (uint8_t *)stack_alloc(need);
+    if (!proc->user_stack)
+    {
+        stack_free(proc->stack_base);
+        proc->stack_base = 0;
+        proc->state = PROC_UNUSED;
+        return 0;
+    }
+    proc->user_stack_size = need;
+    proc->user_entry = entry;
+
     scheduler_add(proc);
     return proc;
 }
@@ -109,11 +293,25 @@ void process_exit(void)
         return;
     }
 
+    if (self->on_exit)
+    {
+        self->on_exit(self);
+        self->on_exit = 0;
+    }
+
+    record_stack_profile(self);
     self->state = PROC_TERMINATED;
+    if (self->user_stack)
+    {
+        stack_free(self->user_stack);
+        self->user_stack = 0;
+    }
     if (self->stack_base)
     {
         stack_free(self->stack_base);
     }
+    arena_release(&self->arena);
+    vm_release(self);
     scheduler_exit_current();
     for (;;)
     {
@@ -121,8 +319,30 @@ void process_exit(void)
     }
 }
 
+void *process_alloc(size_t size)
+{
+    process_t *self = process_current();
+    return self ? arena_alloc(&self->arena, size) : 0;
+}
+
+void process_free(void *ptr)
+{
+    process_t *self = process_current();
+    if (self)
+    {
+        arena_free(&self->arena, ptr);
+    }
+}
+
+void process_set_quota(process_t *proc, uint32_t quota)
+{
+    proc->arena.quota = quota;
+}
+
 void process_init(void)
 {
+    rwlock_init(&table_lock, "process table");
+    arena_cache_init();
     for (int i = 0; i < MAX_PROCESSES; i++)
     {
         process_table[i].pid = 0;
@@ -132,6 +352,12 @@ void process_init(void)
         process_table[i].entry = 0;
         process_table[i].arg = 0;
         process_table[i].next = 0;
+        process_table[i].user_stack = 0;
+        process_table[i].on_exit = 0;
+        process_table[i].fibers = 0;
+        process_table[i].sched_class = SCHED_NORMAL;
+        process_table[i].page_dir = 0;
+        arena_init(&process_table[i].arena, 0);
     }
 }
 
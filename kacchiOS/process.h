@@ -3,8 +3,11 @@
 #define PROCESS_H
 
 #include "types.h"
+#include "percpu.h"
+#include "arena.h"
 
 struct process;
+struct fiber_loop;
 
 typedef enum
 {
@@ -17,13 +20,34 @@ typedef enum
 
 typedef void (*process_entry_t)(void *);
 
+/* Pointer-sized so the hosted build can switch 64-bit stacks */
 typedef struct context
 {
-    uint32_t esp;
-    uint32_t ebp;
-    uint32_t eip;
+    uintptr_t esp;
+    uintptr_t ebp;
+    uintptr_t eip;
 } context_t;
 
+#define SCHED_NORMAL 0
+#define SCHED_DEADLINE 1
+
+/* Deadline class parameters and state, all times in TSC cycles */
+typedef struct sched_dl
+{
+    uint64_t runtime;      /* budget per period */
+    uint64_t deadline;     /* relative to each release */
+    uint64_t period;
+    uint64_t release;      /* start of the next period */
+    uint64_t abs_deadline; /* of the current job */
+    int64_t budget;        /* left in this period */
+    uint32_t util_ppm;     /* runtime / period, parts per million */
+    uint8_t throttled;     /* budget spent; waits for the next release */
+    uint8_t sleeping;      /* job done; waits for the next release */
+    uint32_t jobs;
+    uint32_t misses;
+    uint32_t throttles;
+} sched_dl_t;
+
 typedef struct process
 {
     int pid;
@@ -36,15 +60,48 @@ typedef struct process
     struct process *next;
     uint32_t age;
     uint32_t time_slice;
+    uint8_t *user_stack; /* non-zero for ring 3 processes */
+    size_t user_stack_size;
+    uint32_t user_entry;
+    void (*on_exit)(struct process *proc);
+    struct fiber_loop *fibers; /* set while the process runs fibers (fiber.h) */
+    uint32_t sched_class;
+    sched_dl_t dl;
+    struct process *dl_next; /* all deadline tasks of a run queue */
+    uint32_t page_dir;       /* own page directory, 0 to use the kernel's (paging.h) */
+    uintptr_t vm_next;       /* next free address in the private region */
+    arena_t arena;           /* process_alloc() memory, released whole at exit */
+    uint64_t run_cycles;     /* TSC cycles on the CPU, charged at each switch */
 } process_t;
 
 void process_init(void);
-process_t *process_current(void);
 process_t *process_create(process_entry_t entry, void *arg, size_t stack_size);
+process_t *process_create_user(uint32_t entry, size_t user_stack_size);
+/* Like process_create, but the new process starts with the caller's
+ * private memory (paging.h), shared copy-on-write */
+process_t *process_clone(process_entry_t entry, void *arg, size_t stack_size);
 void process_exit(void);
+/* From the current process's arena; freed when it exits (arena.h) */
+void *process_alloc(size_t size);
+void process_free(void *ptr);
+/* Cap proc's arena at quota bytes of chunks, 0 for no limit */
+void process_set_quota(process_t *proc, uint32_t quota);
 void process_mark_ready(process_t *proc);
 void process_block_current(void);
 int process_get_count(void);
+
+/* A single %gs-relative load; safe on every hot path */
+static inline process_t *process_current(void)
+{
+    return this_cpu->current;
+}
+
+/* Stacks are painted at creation; these report how much was ever used */
+#define PROCESS_STACK_WARN_PERCENT 85
+size_t process_stack_peak(const process_t *proc);
+/* Measured peak for entry plus headroom, capped at fallback (also used
+ * when entry has never run) */
+size_t process_stack_recommend(process_entry_t entry, size_t fallback);
 process_t *process_get_by_index(int idx);
 
 #endif
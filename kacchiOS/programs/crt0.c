@@ -0,0 +1,10 @@
+/* crt0.c - Program entry: run main() and exit through the kernel */
+#include "usys.h"
+
+int main(void);
+
+__attribute__((section(".text.start"))) void _start(void)
+{
+    main();
+    sys_exit();
+}
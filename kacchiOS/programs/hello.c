@@ -0,0 +1,21 @@
+/* hello.c - Sample program loaded from the initrd with 'run hello' */
+#include "usys.h"
+
+static uint32_t runs; /* .bss: reset on every launch */
+
+int main(void)
+{
+    runs++;
+    sys_puts("[hello] pid ");
+    sys_putu((uint32_t)sys_getpid());
+    sys_puts(" says hello from ring 3 (run ");
+    sys_putu(runs);
+    sys_puts(")\n");
+
+    for (int i = 0; i < 3; i++)
+    {
+        sys_yield();
+    }
+    sys_puts("[hello] bye\n");
+    return 0;
+}
@@ -0,0 +1,52 @@
+/* sysbench.c - Cost of a null SYSENTER system call vs. a plain call */
+#include "usys.h"
+
+#define ITERATIONS 10000
+
+__attribute__((noinline)) static uint32_t direct_null(void)
+{
+    __asm__ volatile("" ::: "memory");
+    return 0;
+}
+
+static void report(const char *label, uint64_t total, uint32_t best)
+{
+    /* Totals fit in 32 bits for this iteration count */
+    sys_puts(label);
+    sys_puts(": avg ");
+    sys_putu((uint32_t)total / ITERATIONS);
+    sys_puts(" cycles, min ");
+    sys_putu(best);
+    sys_puts(" cycles\n");
+}
+
+int main(void)
+{
+    uint64_t total = 0;
+    uint32_t best = 0xFFFFFFFF;
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        uint64_t t0 = user_rdtsc();
+        direct_null();
+        uint32_t dt = (uint32_t)(user_rdtsc() - t0);
+        total += dt;
+        if (dt < best)
+            best = dt;
+    }
+    report("[sysbench] direct call", total, best);
+
+    total = 0;
+    best = 0xFFFFFFFF;
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        uint64_t t0 = user_rdtsc();
+        sys_null();
+        uint32_t dt = (uint32_t)(user_rdtsc() - t0);
+        total += dt;
+        if (dt < best)
+            best = dt;
+    }
+    report("[sysbench] sysenter   ", total, best);
+    return 0;
+}
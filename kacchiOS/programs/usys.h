@@ -0,0 +1,70 @@
+/* usys.h - User-side system call stubs for programs run in ring 3 */
+#ifndef USYS_H
+#define USYS_H
+
+#define SYSCALL_USER
+#include "types.h"
+#include "syscall.h"
+
+static inline uint32_t syscall3(uint32_t num, uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t ret;
+    /* ebp is callee-saved but may be the frame pointer, so save it by hand */
+    __asm__ volatile("push %%ebp\n\t"
+                     "mov %%esp, %%ecx\n\t"
+                     "lea 1f, %%edx\n\t"
+                     "sysenter\n"
+                     "1:\n\t"
+                     "pop %%ebp"
+                     : "=a"(ret)
+                     : "a"(num), "b"(a), "S"(b), "D"(c)
+                     : "ecx", "edx", "memory", "cc");
+    return ret;
+}
+
+static inline void sys_exit(void)
+{
+    syscall3(SYS_EXIT, 0, 0, 0);
+    for (;;)
+        ;
+}
+
+static inline void sys_yield(void) { syscall3(SYS_YIELD, 0, 0, 0); }
+static inline int sys_getpid(void) { return (int)syscall3(SYS_GETPID, 0, 0, 0); }
+static inline void sys_putu(uint32_t v) { syscall3(SYS_PUTU, v, 0, 0); }
+static inline int sys_getc(void) { return (int)syscall3(SYS_GETC, 0, 0, 0); }
+static inline void *sys_alloc(size_t n) { return (void *)syscall3(SYS_ALLOC, n, 0, 0); }
+static inline void sys_free(void *p) { syscall3(SYS_FREE, (uint32_t)p, 0, 0); }
+static inline uint32_t sys_null(void) { return syscall3(SYS_NULL, 0, 0, 0); }
+
+static inline int sys_write(const char *buf, uint32_t len)
+{
+    return (int)syscall3(SYS_WRITE, (uint32_t)buf, len, 0);
+}
+
+static inline void sys_puts(const char *s)
+{
+    uint32_t n = 0;
+    while (s[n])
+        n++;
+    sys_write(s, n);
+}
+
+static inline int sys_send(uint32_t queue, uint32_t value)
+{
+    return (int)syscall3(SYS_SEND, queue, value, 0);
+}
+
+static inline int sys_recv(uint32_t queue, uint32_t *out)
+{
+    return (int)syscall3(SYS_RECV, queue, (uint32_t)out, 0);
+}
+
+static inline uint64_t user_rdtsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#endif
@@ -1,25 +1,172 @@
-/* scheduler.c - Round-robin scheduler */
+/* scheduler.c - Round-robin scheduler with an EDF deadline class
+ *
+ * Deadline processes are never on the round-robin ready list; they stay
+ * on their run queue's dl list, and pop_ready() picks the ready one with
+ * the earliest absolute deadline before looking at round-robin work.
+ * Scheduling is cooperative, so budgets are charged at each scheduling
+ * point: a process that overruns is throttled until its next release.
+ */
 #include "scheduler.h"
 #include "serial.h"
+#include "gdt.h"
+#include "percpu.h"
+#include "defer.h"
+#include "cpu.h"
+#include "tsc.h"
+#include "paging.h"
 
-static process_t *ready_head = 0;
-static process_t *ready_tail = 0;
-static process_t *blocked_head = 0;
-static process_t *current = 0;
+/* One per CPU, reached through this_cpu->rq; current lives in percpu_t */
+typedef struct runqueue
+{
+    process_t *ready_head;
+    process_t *ready_tail;
+    process_t *blocked_head;
+    process_t *dl_head;
+    uint32_t dl_count;
+    uint32_t dl_util_ppm;
+    uint64_t run_start; /* TSC at the last scheduling point */
+    uint32_t accounting; /* charge run_cycles at each switch */
+    process_t *on_cpu;   /* switched in last; its run_cycles are accruing */
+    uint64_t switched_at;
+} runqueue_t;
+
+static runqueue_t runqueues[PERCPU_MAX_CPUS];
 static context_t bootstrap_ctx;
 static uint32_t time_quantum_ticks = 1;
 
 extern void context_switch(context_t *old_ctx, context_t *new_ctx);
 
+/* Charge the outgoing process's CPU time and start next's. Off unless
+ * asked for: an rdtsc per switch is a large part of a yield. */
+static void account_switch(process_t *next)
+{
+    runqueue_t *rq = this_cpu->rq;
+    if (!rq->accounting)
+    {
+        return;
+    }
+    uint64_t now = rdtsc();
+    if (rq->on_cpu)
+    {
+        rq->on_cpu->run_cycles += now - rq->switched_at;
+    }
+    rq->on_cpu = next;
+    rq->switched_at = now;
+}
+
+static void switch_to(context_t *old_ctx, process_t *next)
+{
+    account_switch(next);
+    percpu_inc(context_switches);
+    percpu_trace(TRACE_SWITCH, (uint32_t)next->pid);
+    /* Ring 3 processes enter the kernel on top of their own PCB stack */
+    if (next->user_stack)
+    {
+        gdt_set_kernel_stack((uintptr_t)(next->stack_base + next->stack_size));
+    }
+    vm_switch(next);
+    context_switch(old_ctx, &next->ctx);
+}
+
+/* Nothing is runnable: halt, or hand control back to the hosted driver */
+static void idle_forever(context_t *old_ctx)
+{
+#ifdef KACCHI_HOST
+    context_switch(old_ctx, &bootstrap_ctx);
+#else
+    (void)old_ctx;
+#endif
+    for (;;)
+    {
+        __asm__ volatile("hlt");
+    }
+}
+
+/* Start a new job at the period boundary, catching up after long sleeps */
+static void dl_replenish(process_t *p, uint64_t now)
+{
+    sched_dl_t *dl = &p->dl;
+    if (!dl->sleeping && now > dl->abs_deadline)
+    {
+        dl->misses++; /* previous job still unfinished past its deadline */
+    }
+    uint64_t start = now - dl->release >= dl->period ? now : dl->release;
+    dl->abs_deadline = start + dl->deadline;
+    dl->release = start + dl->period;
+    dl->budget = (int64_t)dl->runtime;
+    dl->throttled = 0;
+    if (dl->sleeping)
+    {
+        dl->sleeping = 0;
+        p->state = PROC_READY;
+    }
+}
+
+static process_t *pick_deadline(runqueue_t *rq)
+{
+    uint64_t now = rdtsc();
+    process_t *best = 0;
+    for (process_t *p = rq->dl_head; p; p = p->dl_next)
+    {
+        if (now >= p->dl.release)
+        {
+            dl_replenish(p, now);
+        }
+        if (p->state != PROC_READY || p->dl.throttled)
+        {
+            continue;
+        }
+        if (!best || p->dl.abs_deadline < best->dl.abs_deadline)
+        {
+            best = p;
+        }
+    }
+    if (best)
+    {
+        rq->run_start = now; /* its budget starts counting here */
+    }
+    return best;
+}
+
+/* Charge the time since the last scheduling point to a deadline process */
+static void charge_current(runqueue_t *rq)
+{
+    if (!rq->dl_count)
+    {
+        return;
+    }
+    uint64_t now = rdtsc();
+    process_t *cur = this_cpu->current;
+    if (cur && cur->sched_class == SCHED_DEADLINE)
+    {
+        cur->dl.budget -= (int64_t)(now - rq->run_start);
+        if (cur->dl.budget <= 0 && !cur->dl.throttled)
+        {
+            cur->dl.throttled = 1;
+            cur->dl.throttles++;
+        }
+    }
+    rq->run_start = now;
+}
+
 static process_t *pop_ready(void)
 {
-    process_t *p = ready_head;
+    runqueue_t *rq = this_cpu->rq;
+    if (rq->dl_count)
+    {
+        process_t *dl = pick_deadline(rq);
+        if (dl)
+        {
+            return dl;
+        }
+    }
+    process_t *p = rq->ready_head;
     if (p)
     {
-        ready_head = p->next;
-        if (!ready_head)
+        rq->ready_head = p->next;
+        if (!rq->ready_head)
         {
-            ready_tail = 0;
+            rq->ready_tail = 0;
         }
         p->next = 0;
     }
@@ -28,7 +175,7 @@ static process_t *pop_ready(void)
 
 static void scheduler_age_ready_internal(void)
 {
-    process_t *p = ready_head;
+    process_t *p = this_cpu->rq->ready_head;
     while (p)
     {
         if (p->age < 0xFFFFFFFF)
@@ -39,39 +186,56 @@ static void scheduler_age_ready_internal(void)
     }
 }
 
+/* Like pop_ready(), but while a deadline process sleeps toward its next
+ * release there is still work coming, so spin instead of going idle */
+static process_t *pop_ready_or_wait(void)
+{
+    process_t *next;
+    while (!(next = pop_ready()) && this_cpu->rq->dl_count)
+    {
+        softirq_poll();
+    }
+    return next;
+}
+
 static void place_ready_with_aging(process_t *proc)
 {
     if (!proc)
     {
         return;
     }
+    runqueue_t *rq = this_cpu->rq;
     proc->state = PROC_READY;
     proc->time_slice = time_quantum_ticks;
+    if (proc->sched_class == SCHED_DEADLINE)
+    {
+        return; /* stays on the dl list */
+    }
 
     const uint32_t AGE_THRESHOLD = 3;
 
-    if (!ready_head)
+    if (!rq->ready_head)
     {
-        ready_head = ready_tail = proc;
+        rq->ready_head = rq->ready_tail = proc;
         proc->next = 0;
         return;
     }
 
     if (proc->age >= AGE_THRESHOLD)
     {
-        proc->next = ready_head;
-        ready_head = proc;
-        if (!ready_tail)
+        proc->next = rq->ready_head;
+        rq->ready_head = proc;
+        if (!rq->ready_tail)
         {
-            ready_tail = proc;
+            rq->ready_tail = proc;
         }
         proc->age = 0;
         return;
     }
 
     proc->next = 0;
-    ready_tail->next = proc;
-    ready_tail = proc;
+    rq->ready_tail->next = proc;
+    rq->ready_tail = proc;
 }
 
 void scheduler_add(process_t *proc)
@@ -91,14 +255,21 @@ void scheduler_age_ready(void)
 
 process_t *scheduler_current(void)
 {
-    return current;
+    return this_cpu->current;
 }
 
 void scheduler_init(void)
 {
-    ready_head = ready_tail = 0;
-    blocked_head = 0;
-    current = 0;
+    runqueue_t *rq = &runqueues[this_cpu->cpu_id];
+    rq->ready_head = rq->ready_tail = 0;
+    rq->blocked_head = 0;
+    rq->dl_head = 0;
+    rq->dl_count = 0;
+    rq->dl_util_ppm = 0;
+    rq->accounting = 0;
+    rq->on_cpu = 0;
+    this_cpu->rq = rq;
+    this_cpu->current = 0;
     time_quantum_ticks = 1;
 }
 
@@ -114,14 +285,18 @@ void scheduler_start(void)
     {
         return;
     }
-    current = next;
-    current->state = PROC_CURRENT;
-    context_switch(&bootstrap_ctx, &current->ctx);
+    this_cpu->current = next;
+    next->state = PROC_CURRENT;
+    this_cpu->rq->on_cpu = 0; /* time before this was not a process's */
+    switch_to(&bootstrap_ctx, next);
 }
 
 void scheduler_yield(void)
 {
-    process_t *prev = current;
+    softirq_poll();
+    charge_current(this_cpu->rq);
+    process_t *prev = this_cpu->current;
+    percpu_inc(yields);
     scheduler_age_ready_internal();
     process_t *next = pop_ready();
 
@@ -137,54 +312,61 @@ void scheduler_yield(void)
     }
 
     next->state = PROC_CURRENT;
-    current = next;
-    context_switch(&prev->ctx, &next->ctx);
+    this_cpu->current = next;
+    switch_to(&prev->ctx, next);
 }
 
 void scheduler_exit_current(void)
 {
-    process_t *prev = current;
-    process_t *next = pop_ready();
+    softirq_poll();
+    process_t *prev = this_cpu->current;
+    if (prev && prev->sched_class == SCHED_DEADLINE)
+    {
+        scheduler_clear_deadline(prev);
+    }
+    process_t *next = pop_ready_or_wait();
 
-    current = next;
+    this_cpu->current = next;
     if (next)
     {
         next->state = PROC_CURRENT;
-        context_switch(&prev->ctx, &next->ctx);
+        switch_to(&prev->ctx, next);
     }
 
     /* No runnable processes remain */
-    for (;;)
-    {
-        __asm__ volatile("hlt");
-    }
+    idle_forever(&prev->ctx);
 }
 
 void scheduler_block_current(void)
 {
-    process_t *self = current;
+    process_t *self = this_cpu->current;
     if (!self)
     {
         return;
     }
+    percpu_inc(blocks);
+    percpu_trace(TRACE_BLOCK, (uint32_t)self->pid);
+    runqueue_t *rq = this_cpu->rq;
+    charge_current(rq);
     self->state = PROC_BLOCKED;
     self->age = 0;
-    self->next = blocked_head;
-    blocked_head = self;
+    self->next = rq->blocked_head;
+    rq->blocked_head = self;
 
-    process_t *next = pop_ready();
+    /* Bottom halves run after we are on the blocked list, so a wakeup
+     * raised just before blocking is not lost */
+    softirq_poll();
+
+    process_t *next = pop_ready_or_wait();
     if (!next)
     {
         /* No ready process; system deadlock or all blocked */
-        for (;;)
-        {
-            __asm__ volatile("hlt");
-        }
+        idle_forever(&self->ctx);
     }
 
     next->state = PROC_CURRENT;
-    current = next;
-    context_switch(&self->ctx, &next->ctx);
+    this_cpu->current = next;
+    switch_to(&self->ctx, next);
     /* When unblocked, execution resumes here */
 }
 
@@ -194,8 +376,14 @@ void scheduler_unblock(process_t *proc)
     {
         return;
     }
+    if (proc->sched_class == SCHED_DEADLINE && proc->dl.sleeping)
+    {
+        return; /* only its next release wakes a sleeping deadline process */
+    }
 
-    process_t **pp = &blocked_head;
+    percpu_inc(wakeups);
+    percpu_trace(TRACE_WAKE, (uint32_t)proc->pid);
+    process_t **pp = &this_cpu->rq->blocked_head;
     while (*pp)
     {
         if (*pp == proc)
@@ -210,3 +398,174 @@ void scheduler_unblock(process_t *proc)
     proc->age = 0;
     place_ready_with_aging(proc);
 }
+
+/* Take proc off the round-robin ready list if it is there */
+static void unlink_ready(runqueue_t *rq, process_t *proc)
+{
+    process_t *prev = 0;
+    for (process_t *p = rq->ready_head; p; prev = p, p = p->next)
+    {
+        if (p != proc)
+            continue;
+        if (prev)
+            prev->next = p->next;
+        else
+            rq->ready_head = p->next;
+        if (rq->ready_tail == p)
+            rq->ready_tail = prev;
+        p->next = 0;
+        return;
+    }
+}
+
+int scheduler_set_deadline(process_t *proc, uint32_t runtime_us, uint32_t deadline_us,
+                           uint32_t period_us)
+{
+    runqueue_t *rq = this_cpu->rq;
+    if (!proc || proc->state == PROC_UNUSED || proc->state == PROC_TERMINATED || !runtime_us ||
+        runtime_us > deadline_us || deadline_us > period_us)
+    {
+        return -1;
+    }
+
+    uint32_t util = (uint32_t)udiv64_32((uint64_t)runtime_us * 1000000, period_us);
+    uint32_t others = rq->dl_util_ppm;
+    if (proc->sched_class == SCHED_DEADLINE)
+    {
+        others -= proc->dl.util_ppm;
+    }
+    if (others + util > SCHED_DL_MAX_UTIL_PPM)
+    {
+        return -1;
+    }
+
+    /* Convert first: the first conversion may calibrate the TSC */
+    uint64_t runtime = tsc_us_to_cycles(runtime_us);
+    uint64_t deadline = tsc_us_to_cycles(deadline_us);
+    uint64_t period = tsc_us_to_cycles(period_us);
+    uint64_t now = rdtsc();
+    if (proc->sched_class != SCHED_DEADLINE)
+    {
+        if (proc->state == PROC_READY)
+        {
+            unlink_ready(rq, proc);
+        }
+        if (!rq->dl_count)
+        {
+            rq->run_start = now;
+        }
+        proc->sched_class = SCHED_DEADLINE;
+        proc->dl_next = rq->dl_head;
+        rq->dl_head = proc;
+        rq->dl_count++;
+        proc->dl.jobs = proc->dl.misses = proc->dl.throttles = 0;
+    }
+    rq->dl_util_ppm = others + util;
+
+    sched_dl_t *dl = &proc->dl;
+    dl->runtime = runtime;
+    dl->deadline = deadline;
+    dl->period = period;
+    dl->util_ppm = util;
+    dl->abs_deadline = now + dl->deadline;
+    dl->release = now + dl->period;
+    dl->budget = (int64_t)dl->runtime;
+    dl->throttled = 0;
+    dl->sleeping = 0;
+    return 0;
+}
+
+void scheduler_clear_deadline(process_t *proc)
+{
+    runqueue_t *rq = this_cpu->rq;
+    if (!proc || proc->sched_class != SCHED_DEADLINE)
+    {
+        return;
+    }
+
+    process_t **pp = &rq->dl_head;
+    while (*pp && *pp != proc)
+    {
+        pp = &(*pp)->dl_next;
+    }
+    if (*pp)
+    {
+        *pp = proc->dl_next;
+    }
+    proc->dl_next = 0;
+    rq->dl_count--;
+    rq->dl_util_ppm -= proc->dl.util_ppm;
+    proc->sched_class = SCHED_NORMAL;
+
+    if (proc->dl.sleeping)
+    {
+        proc->dl.sleeping = 0;
+        proc->state = PROC_READY;
+    }
+    if (proc->state == PROC_READY)
+    {
+        place_ready_with_aging(proc);
+    }
+}
+
+int scheduler_dl_wait(void)
+{
+    process_t *self = this_cpu->current;
+    if (!self || self->sched_class != SCHED_DEADLINE)
+    {
+        scheduler_yield();
+        return -1;
+    }
+
+    softirq_poll();
+    charge_current(this_cpu->rq);
+    self->dl.jobs++;
+    if (rdtsc() > self->dl.abs_deadline)
+    {
+        self->dl.misses++;
+    }
+    self->dl.sleeping = 1;
+    self->state = PROC_BLOCKED;
+
+    process_t *next = pop_ready_or_wait();
+    next->state = PROC_CURRENT;
+    this_cpu->current = next;
+    if (next != self)
+    {
+        switch_to(&self->ctx, next);
+    }
+    return 0;
+}
+
+int scheduler_accounting_set(int on)
+{
+    runqueue_t *rq = this_cpu->rq;
+    int was = (int)rq->accounting;
+    if (on && !was)
+    {
+        rq->on_cpu = this_cpu->current;
+        rq->switched_at = rdtsc();
+    }
+    else if (!on && was)
+    {
+        account_switch(0);
+    }
+    rq->accounting = on ? 1 : 0;
+    return was;
+}
+
+uint64_t scheduler_run_cycles(const process_t *proc)
+{
+    runqueue_t *rq = this_cpu->rq;
+    uint64_t cycles = proc->run_cycles;
+    if (rq->accounting && proc == rq->on_cpu)
+    {
+        cycles += rdtsc() - rq->switched_at;
+    }
+    return cycles;
+}
+
+uint32_t scheduler_dl_utilization(void)
+{
+    return this_cpu->rq->dl_util_ppm;
+}
@@ -14,5 +14,23 @@ void scheduler_set_time_quantum(uint32_t ticks);
 void scheduler_block_current(void);
 void scheduler_unblock(process_t *proc);
 void scheduler_age_ready(void);
+/* Charge CPU time to processes at each switch while on; returns the
+ * previous setting. Off by default to keep switches cheap. */
+int scheduler_accounting_set(int on);
+/* CPU time proc has had while accounting was on, in TSC cycles,
+ * including a slice now running */
+uint64_t scheduler_run_cycles(const process_t *proc);
+
+/* Deadline class: each period the process may run for runtime and is
+ * picked earliest-deadline-first ahead of round-robin processes.
+ * Admission fails (-1) if total deadline utilization would pass
+ * SCHED_DL_MAX_UTIL_PPM or unless runtime <= deadline <= period. */
+#define SCHED_DL_MAX_UTIL_PPM 1000000
+int scheduler_set_deadline(process_t *proc, uint32_t runtime_us, uint32_t deadline_us,
+                           uint32_t period_us);
+void scheduler_clear_deadline(process_t *proc);
+/* End the current job and sleep until the next period */
+int scheduler_dl_wait(void);
+uint32_t scheduler_dl_utilization(void);
 
 #endif
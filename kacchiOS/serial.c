@@ -1,8 +1,36 @@
 /* serial.c - Serial port driver (COM1) */
 #include "serial.h"
+#include "cpu.h"
+#include "defer.h"
 #include "io.h"
+#include "irq.h"
+#include "process.h"
+#include "scheduler.h"
+#include "vga.h"
 
 #define COM1 0x3F8 /* I/O port base address for COM1 */
+#define UART_FIFO_SIZE 16
+#define TX_RING_SIZE 2048 /* power of two */
+
+/* Output is queued here and fed to the UART a FIFO-full at a time, so
+ * callers only wait on the line when the ring itself is full */
+static char tx_ring[TX_RING_SIZE];
+static uint32_t tx_head = 0; /* next byte to send */
+static uint32_t tx_tail = 0; /* next free slot */
+
+/* With the receive interrupt on, the top half moves bytes from the UART
+ * into rx_ring and the bottom half wakes the process waiting for input */
+#define RX_RING_SIZE 256 /* power of two */
+static volatile char rx_ring[RX_RING_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static uint32_t rx_dropped = 0;
+static int rx_irq = 0;
+static process_t *rx_waiter = 0;
+static work_t rx_work;
+
+/* Everything printed through serial_putc() goes to each enabled sink */
+static uint32_t outputs = OUTPUT_SERIAL;
 
 /*
 You can find more information here: https://caro.su/msx/ocm_de1/16550.pdf
@@ -26,7 +54,7 @@ void serial_init(void)
 {
     outb(COM1 + 1, 0x00); /* Disable interrupts */
     outb(COM1 + 3, 0x80); /* Enable DLAB (set baud rate divisor) */
-    outb(COM1 + 0, 0x03); /* Divisor low byte (38400 baud) */
+    outb(COM1 + 0, 0x01); /* Divisor low byte (115200 baud) */
     outb(COM1 + 1, 0x00); /* Divisor high byte */
     outb(COM1 + 3, 0x03); /* 8 bits, no parity, 1 stop bit */
     outb(COM1 + 2, 0xC7); /* Enable FIFO, clear, 14-byte threshold */
@@ -38,15 +66,86 @@ static int is_transmit_empty(void)
     return inb(COM1 + 5) & 0x20;
 }
 
-void serial_putc(char c)
+/* Refill the UART FIFO if it has drained; never waits */
+static void uart_pump(void)
 {
-    if (c == '\n')
+    if (tx_head == tx_tail || !is_transmit_empty())
+    {
+        return;
+    }
+    for (int i = 0; i < UART_FIFO_SIZE && tx_head != tx_tail; i++)
+    {
+        outb(COM1, tx_ring[tx_head]);
+        tx_head = (tx_head + 1) & (TX_RING_SIZE - 1);
+    }
+}
+
+/* Output pump: feed the UART and push dirty console rows to the screen */
+void serial_poll(void)
+{
+    uart_pump();
+    if (outputs & OUTPUT_VGA)
+    {
+        vga_flush();
+    }
+}
+
+void serial_flush(void)
+{
+    if (outputs & OUTPUT_VGA)
+    {
+        vga_flush();
+    }
+    while (tx_head != tx_tail)
     {
-        serial_putc('\r'); /* Add carriage return */
+        uart_pump();
     }
     while (!is_transmit_empty())
         ;
-    outb(COM1, c);
+}
+
+void serial_set_outputs(uint32_t mask)
+{
+    serial_flush();
+    if ((mask & OUTPUT_VGA) && !(outputs & OUTPUT_VGA))
+    {
+        vga_init();
+    }
+    outputs = mask;
+}
+
+uint32_t serial_outputs(void)
+{
+    return outputs;
+}
+
+static void tx_push(char c)
+{
+    uint32_t next = (tx_tail + 1) & (TX_RING_SIZE - 1);
+    while (next == tx_head)
+    {
+        uart_pump(); /* ring full: fall back to waiting on the line */
+    }
+    tx_ring[tx_tail] = c;
+    tx_tail = next;
+}
+
+void serial_putc(char c)
+{
+    if (outputs & OUTPUT_VGA)
+    {
+        vga_putc(c); /* reaches the screen at the next serial_poll() */
+    }
+    if (!(outputs & OUTPUT_SERIAL))
+    {
+        return;
+    }
+    if (c == '\n')
+    {
+        tx_push('\r'); /* Add carriage return */
+    }
+    tx_push(c);
+    uart_pump();
 }
 
 void serial_puts(const char *str)
@@ -57,19 +156,105 @@ void serial_puts(const char *str)
     }
 }
 
+void serial_putu(uint32_t value)
+{
+    char buf[11];
+    int idx = 0;
+    do
+    {
+        buf[idx++] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value && idx < 10);
+    while (idx--)
+    {
+        serial_putc(buf[idx]);
+    }
+}
+
 static int serial_received(void)
 {
     return inb(COM1 + 5) & 0x01;
 }
 
+static void serial_irq(void)
+{
+    while (serial_received())
+    {
+        char c = inb(COM1);
+        uint32_t next = (rx_tail + 1) & (RX_RING_SIZE - 1);
+        if (next == rx_head)
+        {
+            rx_dropped++;
+            continue;
+        }
+        rx_ring[rx_tail] = c;
+        rx_tail = next;
+    }
+    work_queue(&rx_work);
+}
+
+static void rx_bottom_half(work_t *work, uint32_t count)
+{
+    (void)work;
+    (void)count;
+    process_t *waiter = rx_waiter;
+    if (waiter)
+    {
+        rx_waiter = 0;
+        scheduler_unblock(waiter);
+    }
+}
+
+int serial_enable_irq(void)
+{
+    work_init(&rx_work, rx_bottom_half, 0);
+    if (irq_register(IRQ_COM1, serial_irq) < 0)
+    {
+        return -1;
+    }
+    rx_irq = 1;
+    outb(COM1 + 1, 0x01); /* interrupt on received data */
+    return 0;
+}
+
+uint32_t serial_rx_dropped(void)
+{
+    return rx_dropped;
+}
+
 int serial_available(void)
 {
-    return serial_received();
+    serial_poll(); /* input loops double as the output pump */
+    return rx_irq ? rx_head != rx_tail : serial_received();
 }
 
 char serial_getc(void)
 {
-    while (!serial_received())
+    if (!rx_irq)
+    {
+        while (!serial_received())
+            ;
+        return inb(COM1);
+    }
+    while (rx_head == rx_tail)
         ;
-    return inb(COM1);
+    char c = rx_ring[rx_head];
+    rx_head = (rx_head + 1) & (RX_RING_SIZE - 1);
+    return c;
+}
+
+void serial_wait_input(void)
+{
+    process_t *self = process_current();
+    uint32_t flags = irq_save();
+    if (!rx_irq || !self || rx_head != rx_tail)
+    {
+        irq_restore(flags);
+        scheduler_yield();
+        return;
+    }
+    rx_waiter = self;
+    irq_restore(flags);
+    serial_poll(); /* show the prompt before sleeping */
+    process_block_current();
 }
@@ -7,7 +7,22 @@
 void serial_init(void);
 void serial_putc(char c);
 void serial_puts(const char *str);
+void serial_putu(uint32_t value);
 char serial_getc(void);
 int serial_available(void);
+void serial_poll(void);
+void serial_flush(void);
+
+/* Output sinks for serial_putc()/serial_puts(); input is always COM1 */
+#define OUTPUT_SERIAL 0x1
+#define OUTPUT_VGA 0x2
+void serial_set_outputs(uint32_t mask);
+uint32_t serial_outputs(void);
+
+/* Receive by interrupt; until this is called input is polled */
+int serial_enable_irq(void);
+/* Block the caller until input arrives (yields if input is polled) */
+void serial_wait_input(void);
+uint32_t serial_rx_dropped(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+/* shm.c - Named shared memory segments */
+#include "shm.h"
+#include "paging.h"
+#include "pmm.h"
+#include "string.h"
+
+typedef struct shm_segment
+{
+    int used;
+    char name[SHM_NAME_MAX];
+    uint32_t pages;
+    uint32_t mappers;
+    uint32_t *frames; /* one frame holding the frame addresses */
+} shm_segment_t;
+
+static shm_segment_t segments[SHM_MAX_SEGMENTS];
+
+static void release_frames(shm_segment_t *seg)
+{
+    for (uint32_t i = 0; i < seg->pages; i++)
+    {
+        pmm_put(seg->frames[i]);
+    }
+    pmm_put((uint32_t)seg->frames);
+    seg->used = 0;
+}
+
+int shm_open(const char *name, size_t size)
+{
+    size_t len = strlen(name);
+    if (!len || len >= SHM_NAME_MAX)
+    {
+        return -1;
+    }
+
+    shm_segment_t *free_slot = 0;
+    for (int i = 0; i < SHM_MAX_SEGMENTS; i++)
+    {
+        if (segments[i].used && strcmp(segments[i].name, name) == 0)
+        {
+            return i;
+        }
+        if (!segments[i].used && !free_slot)
+        {
+            free_slot = &segments[i];
+        }
+    }
+
+    uint32_t pages = (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (!free_slot || !pages || pages > SHM_MAX_PAGES)
+    {
+        return -1;
+    }
+    shm_segment_t *seg = free_slot;
+    seg->frames = (uint32_t *)pmm_alloc();
+    if (!seg->frames)
+    {
+        return -1;
+    }
+    seg->used = 1;
+    seg->pages = 0;
+    for (; seg->pages < pages; seg->pages++)
+    {
+        uint32_t frame = pmm_alloc();
+        if (!frame)
+        {
+            release_frames(seg);
+            return -1;
+        }
+        seg->frames[seg->pages] = frame;
+    }
+    memcpy(seg->name, name, len + 1);
+    seg->mappers = 0;
+    return (int)(seg - segments);
+}
+
+void *shm_map(int id)
+{
+    if (id < 0 || id >= SHM_MAX_SEGMENTS || !segments[id].used)
+    {
+        return 0;
+    }
+    shm_segment_t *seg = &segments[id];
+    void *addr = vm_map_shared(seg->frames, seg->pages);
+    if (addr)
+    {
+        seg->mappers++;
+    }
+    return addr;
+}
+
+int shm_unlink(int id)
+{
+    if (id < 0 || id >= SHM_MAX_SEGMENTS || !segments[id].used)
+    {
+        return -1;
+    }
+    release_frames(&segments[id]);
+    return 0;
+}
+
+int shm_get_info(int id, shm_info_t *out)
+{
+    if (id < 0 || id >= SHM_MAX_SEGMENTS || !segments[id].used || !out)
+    {
+        return -1;
+    }
+    memcpy(out->name, segments[id].name, SHM_NAME_MAX);
+    out->pages = segments[id].pages;
+    out->mappers = segments[id].mappers;
+    return 0;
+}
@@ -0,0 +1,32 @@
+/* shm.h - Named shared memory segments
+ *
+ * A segment is a set of frames held by name. Every process that maps it
+ * sees the same frames, writable and never copied on clone; the frames
+ * are freed once the segment is unlinked and the last mapper exits.
+ */
+#ifndef SHM_H
+#define SHM_H
+
+#include "types.h"
+
+#define SHM_MAX_SEGMENTS 8
+#define SHM_NAME_MAX 16
+#define SHM_MAX_PAGES 1024 /* frame list fits in one frame: 4 MB */
+
+typedef struct shm_info
+{
+    char name[SHM_NAME_MAX];
+    uint32_t pages;
+    uint32_t mappers; /* times it has been mapped */
+} shm_info_t;
+
+/* Open the segment called name, creating it with size bytes if there is
+ * none; returns its id, or -1 (no memory, no slot, or size too large) */
+int shm_open(const char *name, size_t size);
+/* Map segment id into the current process; 0 on failure */
+void *shm_map(int id);
+/* Drop the name; mappings stay valid until their processes exit */
+int shm_unlink(int id);
+int shm_get_info(int id, shm_info_t *out);
+
+#endif
@@ -0,0 +1,262 @@
+/* spinlock.c - Ticket, MCS and reader-writer locks with contention stats
+ *
+ * The _smp functions are the multiprocessor paths behind the inline
+ * wrappers in spinlock.h.
+ */
+#include "spinlock.h"
+
+#define RW_WRITER 0x80000000u
+
+int lock_timing = 0;
+static lock_stats_t *registry = 0;
+
+static inline void cpu_relax(void)
+{
+    __asm__ volatile("pause" : : : "memory");
+}
+
+static void stats_register(lock_stats_t *stats, const char *name)
+{
+    stats->name = name;
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->spin_cycles = 0;
+    stats->max_hold_cycles = 0;
+    stats->hold_start = 0;
+    if (!stats->registered)
+    {
+        stats->registered = 1;
+        stats->next = registry;
+        registry = stats;
+    }
+}
+
+void lock_acquired_slow(lock_stats_t *stats, uint64_t spin_start)
+{
+    uint64_t now = rdtsc();
+    if (spin_start)
+    {
+        stats->contended++;
+        stats->spin_cycles += now - spin_start;
+    }
+    stats->hold_start = lock_timing ? now : 0;
+}
+
+void lock_released_slow(lock_stats_t *stats)
+{
+    if (stats->hold_start)
+    {
+        uint64_t held = rdtsc() - stats->hold_start;
+        if (held > stats->max_hold_cycles)
+        {
+            stats->max_hold_cycles = held > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)held;
+        }
+        stats->hold_start = 0;
+    }
+}
+
+/* Counting for the _smp paths, which have already waited or not */
+static inline void smp_acquired(lock_stats_t *stats, uint64_t spin_start)
+{
+    stats->acquisitions++;
+    if (spin_start || lock_timing)
+    {
+        lock_acquired_slow(stats, spin_start);
+    }
+}
+
+static inline void smp_released(lock_stats_t *stats)
+{
+    if (lock_timing)
+    {
+        lock_released_slow(stats);
+    }
+}
+
+void spin_lock_init(spinlock_t *lock, const char *name)
+{
+    lock->next = 0;
+    lock->owner = 0;
+    stats_register(&lock->stats, name);
+}
+
+uint32_t spin_lock_smp(spinlock_t *lock)
+{
+    uint32_t flags = irq_save();
+    uint16_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    uint64_t spin_start = 0;
+    if (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket)
+    {
+        spin_start = rdtsc();
+        while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket)
+        {
+            cpu_relax();
+        }
+    }
+    smp_acquired(&lock->stats, spin_start);
+    return flags;
+}
+
+int spin_trylock_smp(spinlock_t *lock, uint32_t *flags)
+{
+    *flags = irq_save();
+    uint16_t owner = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+    uint16_t expected = owner;
+    if (!__atomic_compare_exchange_n(&lock->next, &expected, (uint16_t)(owner + 1), 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        irq_restore(*flags);
+        return 0;
+    }
+    smp_acquired(&lock->stats, 0);
+    return 1;
+}
+
+void spin_unlock_smp(spinlock_t *lock, uint32_t flags)
+{
+    smp_released(&lock->stats);
+    __atomic_store_n(&lock->owner, (uint16_t)(lock->owner + 1), __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+void mcs_lock_init(mcs_lock_t *lock, const char *name)
+{
+    lock->tail = 0;
+    stats_register(&lock->stats, name);
+}
+
+uint32_t mcs_lock_smp(mcs_lock_t *lock, mcs_node_t *node)
+{
+    uint32_t flags = irq_save();
+    node->next = 0;
+    node->waiting = 1;
+    mcs_node_t *prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    uint64_t spin_start = 0;
+    if (prev)
+    {
+        spin_start = rdtsc();
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->waiting, __ATOMIC_ACQUIRE))
+        {
+            cpu_relax(); /* on our own node, not the shared tail */
+        }
+    }
+    smp_acquired(&lock->stats, spin_start);
+    return flags;
+}
+
+void mcs_unlock_smp(mcs_lock_t *lock, mcs_node_t *node, uint32_t flags)
+{
+    smp_released(&lock->stats);
+    mcs_node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (!next)
+    {
+        mcs_node_t *expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, 0, 0, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED))
+        {
+            irq_restore(flags);
+            return;
+        }
+        /* A waiter swapped itself in but has not linked to us yet */
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+        {
+            cpu_relax();
+        }
+    }
+    __atomic_store_n(&next->waiting, 0, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+void rwlock_init(rwlock_t *lock, const char *name)
+{
+    lock->state = 0;
+    lock->writers_waiting = 0;
+    stats_register(&lock->stats, name);
+}
+
+uint32_t read_lock_smp(rwlock_t *lock)
+{
+    uint32_t flags = irq_save();
+    uint64_t spin_start = 0;
+    for (;;)
+    {
+        uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+        if (!(state & RW_WRITER) && !__atomic_load_n(&lock->writers_waiting, __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(&lock->state, &state, state + 1, 1, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED))
+        {
+            break;
+        }
+        if (!spin_start)
+        {
+            spin_start = rdtsc();
+        }
+        cpu_relax();
+    }
+    /* Other readers are inside too, so the counters need atomic adds */
+    __atomic_fetch_add(&lock->stats.acquisitions, 1, __ATOMIC_RELAXED);
+    if (spin_start)
+    {
+        __atomic_fetch_add(&lock->stats.contended, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&lock->stats.spin_cycles, rdtsc() - spin_start, __ATOMIC_RELAXED);
+    }
+    return flags;
+}
+
+void read_unlock_smp(rwlock_t *lock, uint32_t flags)
+{
+    __atomic_fetch_sub(&lock->state, 1, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+uint32_t write_lock_smp(rwlock_t *lock)
+{
+    uint32_t flags = irq_save();
+    uint32_t expected = 0;
+    uint64_t spin_start = 0;
+    if (!__atomic_compare_exchange_n(&lock->state, &expected, RW_WRITER, 0, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED))
+    {
+        /* Hold new readers back until we are in */
+        spin_start = rdtsc();
+        __atomic_fetch_add(&lock->writers_waiting, 1, __ATOMIC_RELAXED);
+        do
+        {
+            cpu_relax();
+            expected = 0;
+        } while (!__atomic_compare_exchange_n(&lock->state, &expected, RW_WRITER, 1,
+                                              __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+        __atomic_fetch_sub(&lock->writers_waiting, 1, __ATOMIC_RELAXED);
+    }
+    smp_acquired(&lock->stats, spin_start);
+    return flags;
+}
+
+void write_unlock_smp(rwlock_t *lock, uint32_t flags)
+{
+    smp_released(&lock->stats);
+    __atomic_store_n(&lock->state, 0, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+const lock_stats_t *lock_stats_first(void)
+{
+    return registry;
+}
+
+void lock_stats_reset(void)
+{
+    for (lock_stats_t *s = registry; s; s = s->next)
+    {
+        s->acquisitions = 0;
+        s->contended = 0;
+        s->spin_cycles = 0;
+        s->max_hold_cycles = 0;
+    }
+}
+
+void lock_timing_set(int on)
+{
+    lock_timing = on;
+}
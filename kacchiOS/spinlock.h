@@ -0,0 +1,189 @@
+/* spinlock.h - Ticket and MCS spinlocks, reader-writer locks
+ *
+ * Every lock here disables interrupts on the local CPU while held (the
+ * _irqsave forms return the flags to hand back on unlock), so a holder
+ * is never interrupted by a handler that wants the same lock. Holders
+ * must not block or yield: with cooperative scheduling another process
+ * on this CPU spinning on the lock would never let the holder run.
+ *
+ * Ticket locks are fair and cost one atomic add to take. MCS locks
+ * queue waiters on nodes they own, so under heavy contention each CPU
+ * spins on its own cache line instead of the lock word. rwlocks let
+ * readers in together and hold new readers back while a writer waits.
+ *
+ * With PERCPU_MAX_CPUS == 1 disabling interrupts is all the exclusion
+ * needed, so the inline wrappers below skip the atomic _smp paths and
+ * only keep the counters. The host lock benchmark sets LOCK_SMP=1.
+ *
+ * Each lock is registered by name for the 'locks' command. Counting
+ * acquisitions costs one increment; spin cycles are only measured when
+ * the first attempt fails, and hold times only while lock_timing_set(1).
+ */
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "cpu.h"
+#include "percpu.h"
+
+typedef struct lock_stats
+{
+    const char *name;
+    uint32_t acquisitions;
+    uint32_t contended; /* acquisitions that had to wait */
+    uint64_t spin_cycles;
+    uint32_t max_hold_cycles;
+    uint32_t registered;
+    uint64_t hold_start;
+    struct lock_stats *next;
+} lock_stats_t;
+
+typedef struct spinlock
+{
+    volatile uint16_t next; /* ticket handed to the next arrival */
+    volatile uint16_t owner; /* ticket now allowed in */
+    lock_stats_t stats;
+} spinlock_t;
+
+typedef struct mcs_node
+{
+    struct mcs_node *volatile next;
+    volatile uint32_t waiting;
+} mcs_node_t;
+
+typedef struct mcs_lock
+{
+    mcs_node_t *volatile tail;
+    lock_stats_t stats;
+} mcs_lock_t;
+
+/* Bit 31 set: a writer holds it; low bits count readers inside */
+typedef struct rwlock
+{
+    volatile uint32_t state;
+    volatile uint32_t writers_waiting;
+    lock_stats_t stats;
+} rwlock_t;
+
+#ifndef LOCK_SMP
+#define LOCK_SMP (PERCPU_MAX_CPUS > 1)
+#endif
+
+extern int lock_timing;
+/* Out of line: contention and hold-time bookkeeping */
+void lock_acquired_slow(lock_stats_t *stats, uint64_t spin_start);
+void lock_released_slow(lock_stats_t *stats);
+
+/* The whole lock on one CPU: interrupts off plus the counters */
+static inline uint32_t lock_up_acquire(lock_stats_t *stats)
+{
+    uint32_t flags = irq_save();
+    stats->acquisitions++;
+    if (lock_timing)
+    {
+        lock_acquired_slow(stats, 0);
+    }
+    return flags;
+}
+
+static inline void lock_up_release(lock_stats_t *stats, uint32_t flags)
+{
+    if (lock_timing)
+    {
+        lock_released_slow(stats);
+    }
+    irq_restore(flags);
+}
+
+uint32_t spin_lock_smp(spinlock_t *lock);
+void spin_unlock_smp(spinlock_t *lock, uint32_t flags);
+int spin_trylock_smp(spinlock_t *lock, uint32_t *flags);
+uint32_t mcs_lock_smp(mcs_lock_t *lock, mcs_node_t *node);
+void mcs_unlock_smp(mcs_lock_t *lock, mcs_node_t *node, uint32_t flags);
+uint32_t read_lock_smp(rwlock_t *lock);
+void read_unlock_smp(rwlock_t *lock, uint32_t flags);
+uint32_t write_lock_smp(rwlock_t *lock);
+void write_unlock_smp(rwlock_t *lock, uint32_t flags);
+
+void spin_lock_init(spinlock_t *lock, const char *name);
+
+static inline uint32_t spin_lock_irqsave(spinlock_t *lock)
+{
+    return LOCK_SMP ? spin_lock_smp(lock) : lock_up_acquire(&lock->stats);
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags)
+{
+    if (LOCK_SMP)
+        spin_unlock_smp(lock, flags);
+    else
+        lock_up_release(&lock->stats, flags);
+}
+
+/* 1 and the saved flags in *flags if taken without waiting */
+static inline int spin_trylock_irqsave(spinlock_t *lock, uint32_t *flags)
+{
+    if (LOCK_SMP)
+        return spin_trylock_smp(lock, flags);
+    *flags = lock_up_acquire(&lock->stats);
+    return 1;
+}
+
+void mcs_lock_init(mcs_lock_t *lock, const char *name);
+
+/* node must stay valid until the matching unlock; a local will do */
+static inline uint32_t mcs_lock_irqsave(mcs_lock_t *lock, mcs_node_t *node)
+{
+    if (LOCK_SMP)
+        return mcs_lock_smp(lock, node);
+    (void)node;
+    return lock_up_acquire(&lock->stats);
+}
+
+static inline void mcs_unlock_irqrestore(mcs_lock_t *lock, mcs_node_t *node, uint32_t flags)
+{
+    if (LOCK_SMP)
+        mcs_unlock_smp(lock, node, flags);
+    else
+        lock_up_release(&lock->stats, flags);
+}
+
+void rwlock_init(rwlock_t *lock, const char *name);
+
+/* Readers overlap, so only writers have their hold time measured */
+static inline uint32_t read_lock_irqsave(rwlock_t *lock)
+{
+    if (LOCK_SMP)
+        return read_lock_smp(lock);
+    uint32_t flags = irq_save();
+    lock->stats.acquisitions++;
+    return flags;
+}
+
+static inline void read_unlock_irqrestore(rwlock_t *lock, uint32_t flags)
+{
+    if (LOCK_SMP)
+        read_unlock_smp(lock, flags);
+    else
+        irq_restore(flags);
+}
+
+static inline uint32_t write_lock_irqsave(rwlock_t *lock)
+{
+    return LOCK_SMP ? write_lock_smp(lock) : lock_up_acquire(&lock->stats);
+}
+
+static inline void write_unlock_irqrestore(rwlock_t *lock, uint32_t flags)
+{
+    if (LOCK_SMP)
+        write_unlock_smp(lock, flags);
+    else
+        lock_up_release(&lock->stats, flags);
+}
+
+/* Registered locks, most recently registered first */
+const lock_stats_t *lock_stats_first(void);
+void lock_stats_reset(void);
+void lock_timing_set(int on);
+
+#endif
@@ -0,0 +1,406 @@
+/* stress.c - Parameterised synthetic workloads with a summary report
+ *
+ * The calling process (the shell) acts as controller: it spawns the
+ * workers, yields until the duration has passed, raises the stop flag,
+ * waits for every worker to exit and then prints throughput per
+ * workload, each worker's share of measured CPU time and the heap
+ * fragmentation left behind.
+ */
+#include "stress.h"
+#include "cpu.h"
+#include "ipc.h"
+#include "memory.h"
+#include "process.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "tsc.h"
+
+#define WORKER_STACK 1024
+#define CHILD_STACK 512
+#define SPIN_UNIT 20000
+#define CHURN_SLOTS 16
+#define CHILD_ALLOCS 4
+#define PAIR_STOP 0xFFFFFFFE /* ~0 cannot survive the IPC direct handoff */
+
+enum
+{
+    KIND_CPU,
+    KIND_PRODUCER,
+    KIND_CONSUMER,
+    KIND_CHURN,
+    KIND_SPAWN
+};
+
+typedef struct stress_worker
+{
+    int kind;
+    int pid;
+    uint32_t ops;
+    uint32_t failures;
+    uint64_t cycles; /* CPU time at exit, from the scheduler */
+    ipc_queue_t *queue;
+    uint32_t rng;
+} stress_worker_t;
+
+static const char *kind_names[] = {"cpu", "producer", "consumer", "churn", "spawn"};
+
+static stress_worker_t workers[STRESS_MAX_WORKERS];
+static uint32_t worker_count = 0;
+static const stress_config_t *active_cfg = 0;
+static volatile int stop_flag = 0;
+static volatile int live = 0;
+
+static uint32_t rng_next(stress_worker_t *w)
+{
+    w->rng = w->rng * 1103515245u + 12345u;
+    return w->rng >> 8;
+}
+
+static uint32_t pick_size(stress_worker_t *w)
+{
+    uint32_t lo = active_cfg->size_min;
+    uint32_t span = active_cfg->size_max - lo + 1;
+    switch (active_cfg->dist)
+    {
+    case STRESS_DIST_SMALL:
+    {
+        /* Minimum of two draws skews towards small sizes */
+        uint32_t a = rng_next(w) % span;
+        uint32_t b = rng_next(w) % span;
+        return lo + (a < b ? a : b);
+    }
+    case STRESS_DIST_BIMODAL:
+        return (rng_next(w) % 10) ? lo : active_cfg->size_max;
+    default:
+        return lo + rng_next(w) % span;
+    }
+}
+
+/* Share of the CPU comes from the scheduler's accounting, so time spent
+ * blocked in ipc_send/ipc_recv is charged to whoever ran meanwhile */
+static void worker_done(stress_worker_t *w)
+{
+    w->cycles = scheduler_run_cycles(process_current());
+    live--;
+}
+
+static void cpu_worker(void *arg)
+{
+    stress_worker_t *w = (stress_worker_t *)arg;
+    while (!stop_flag)
+    {
+        for (volatile uint32_t i = 0; i < SPIN_UNIT; i++)
+            ;
+        w->ops++;
+        scheduler_yield();
+    }
+    worker_done(w);
+}
+
+static void producer_worker(void *arg)
+{
+    stress_worker_t *w = (stress_worker_t *)arg;
+    uint32_t seq = 0;
+    while (!stop_flag)
+    {
+        ipc_send(w->queue, seq++ & 0x7FFFFFFF);
+        w->ops++;
+        scheduler_yield();
+    }
+    ipc_send(w->queue, PAIR_STOP);
+    worker_done(w);
+}
+
+static void consumer_worker(void *arg)
+{
+    stress_worker_t *w = (stress_worker_t *)arg;
+    uint32_t v;
+    while (1)
+    {
+        ipc_recv(w->queue, &v);
+        if (v == PAIR_STOP)
+        {
+            break;
+        }
+        w->ops++;
+    }
+    worker_done(w);
+}
+
+static void churn_worker(void *arg)
+{
+    stress_worker_t *w = (stress_worker_t *)arg;
+    void *slots[CHURN_SLOTS];
+    for (int i = 0; i < CHURN_SLOTS; i++)
+    {
+        slots[i] = 0;
+    }
+
+    while (!stop_flag)
+    {
+        uint32_t s = rng_next(w) % CHURN_SLOTS;
+        if (slots[s])
+        {
+            heap_free(slots[s]);
+            slots[s] = 0;
+        }
+        else
+        {
+            slots[s] = heap_alloc(pick_size(w));
+            if (!slots[s])
+                w->failures++;
+        }
+        w->ops++;
+        scheduler_yield();
+    }
+    for (int i = 0; i < CHURN_SLOTS; i++)
+    {
+        heap_free(slots[i]);
+    }
+    worker_done(w);
+}
+
+/* Never frees: the whole arena goes back when the child exits */
+static void short_lived_child(void *arg)
+{
+    stress_worker_t *w = (stress_worker_t *)arg;
+    for (int i = 0; i < CHILD_ALLOCS; i++)
+    {
+        uint8_t *p = (uint8_t *)process_alloc(pick_size(w));
+        if (!p)
+        {
+            w->failures++;
+            break;
+        }
+        p[0] = (uint8_t)i;
+    }
+    live--;
+}
+
+static void spawn_worker(void *arg)
+{
+    stress_worker_t *w = (stress_worker_t *)arg;
+    while (!stop_flag)
+    {
+        live++;
+        if (process_create(short_lived_child, w, process_stack_recommend(short_lived_child, CHILD_STACK)))
+        {
+            w->ops++;
+        }
+        else
+        {
+            live--;
+            w->failures++;
+        }
+        scheduler_yield();
+    }
+    worker_done(w);
+}
+
+static int start_worker(int kind, process_entry_t entry, ipc_queue_t *queue)
+{
+    if (worker_count == STRESS_MAX_WORKERS)
+    {
+        return -1;
+    }
+    stress_worker_t *w = &workers[worker_count];
+    w->kind = kind;
+    w->ops = 0;
+    w->failures = 0;
+    w->cycles = 0;
+    w->queue = queue;
+    w->rng = 0x9E3779B9u * (worker_count + 1);
+
+    /* Earlier runs leave stack profiles; size from them once measured */
+    process_t *proc = process_create(entry, w, process_stack_recommend(entry, WORKER_STACK));
+    if (!proc)
+    {
+        return -1;
+    }
+    w->pid = proc->pid;
+    worker_count++;
+    live++;
+    return 0;
+}
+
+static void print_row(const char *label, uint32_t value, const char *unit)
+{
+    serial_puts(label);
+    serial_putu(value);
+    serial_puts(unit);
+}
+
+static void report(uint32_t elapsed_ms)
+{
+    uint64_t total_cycles = 0;
+    uint32_t kind_ops[5] = {0, 0, 0, 0, 0};
+    uint32_t failures = 0;
+
+    for (uint32_t i = 0; i < worker_count; i++)
+    {
+        total_cycles += workers[i].cycles;
+        kind_ops[workers[i].kind] += workers[i].ops;
+        failures += workers[i].failures;
+    }
+
+    serial_puts("== stress report (");
+    serial_putu(elapsed_ms);
+    serial_puts(" ms) ==\n");
+    const char *labels[] = {"  cpu units:     ", "  ipc sent:      ", "  ipc received:  ",
+                            "  alloc/free ops:", "  spawns:        "};
+    for (int k = 0; k < 5; k++)
+    {
+        if (!kind_ops[k])
+            continue;
+        print_row(labels[k], kind_ops[k], "");
+        print_row(" (", elapsed_ms ? (uint32_t)udiv64_32((uint64_t)kind_ops[k] * 1000, elapsed_ms) : 0,
+                  "/s)\n");
+    }
+    if (failures)
+    {
+        print_row("  failed allocs/spawns: ", failures, "\n");
+    }
+
+    /* Shares in permille; scale cycles down so 32-bit math is enough */
+    int shift = 0;
+    while ((total_cycles >> shift) > 0xFFFFFu)
+        shift++;
+    uint32_t total = (uint32_t)(total_cycles >> shift);
+
+    serial_puts("  PID  WORKLOAD   OPS        SHARE\n");
+    uint32_t cpu_n = 0;
+    uint32_t cpu_max = 0;
+    for (uint32_t i = 0; i < worker_count; i++)
+    {
+        uint32_t share = total ? (uint32_t)(workers[i].cycles >> shift) * 1000 / total : 0;
+        serial_puts("  ");
+        serial_putu(workers[i].pid);
+        serial_puts("    ");
+        serial_puts(kind_names[workers[i].kind]);
+        serial_puts("  ");
+        serial_putu(workers[i].ops);
+        serial_puts("  ");
+        serial_putu(share / 10);
+        serial_puts(".");
+        serial_putu(share % 10);
+        serial_puts("%\n");
+        if (workers[i].kind == KIND_CPU)
+        {
+            cpu_n++;
+            if (workers[i].ops > cpu_max)
+                cpu_max = workers[i].ops;
+        }
+    }
+
+    /* Jain's index over spinner progress: 1.0 means perfectly even.
+     * Counts are scaled to 8 bits so the squares fit the 32-bit divisor. */
+    if (cpu_n > 1 && cpu_max)
+    {
+        uint32_t sum = 0, sum_sq = 0;
+        for (uint32_t i = 0; i < worker_count; i++)
+        {
+            if (workers[i].kind != KIND_CPU)
+                continue;
+            uint32_t x = (uint32_t)udiv64_32((uint64_t)workers[i].ops * 255, cpu_max);
+            sum += x;
+            sum_sq += x * x;
+        }
+        uint32_t jain = sum_sq ? (uint32_t)udiv64_32((uint64_t)sum * sum * 1000, cpu_n * sum_sq) : 0;
+        print_row("  cpu fairness (Jain x1000): ", jain, "\n");
+    }
+
+    uint32_t total_free, largest;
+    memory_get_stats(&total_free, &largest);
+    uint32_t frag = total_free ? 100 - (largest * 100) / total_free : 0;
+    print_row("  heap free ", total_free, " bytes");
+    print_row(", largest block ", largest, " bytes");
+    print_row(", fragmentation ", frag, "%\n");
+}
+
+void stress_default_config(stress_config_t *cfg)
+{
+    cfg->cpu = 2;
+    cfg->pairs = 1;
+    cfg->churn = 1;
+    cfg->spawners = 1;
+    cfg->duration_ms = 2000;
+    cfg->size_min = 16;
+    cfg->size_max = 512;
+    cfg->dist = STRESS_DIST_UNIFORM;
+}
+
+int stress_run(const stress_config_t *cfg)
+{
+    if (!cfg || cfg->size_min == 0 || cfg->size_max < cfg->size_min)
+    {
+        return -1;
+    }
+
+    active_cfg = cfg;
+    worker_count = 0;
+    stop_flag = 0;
+    live = 0;
+    int was_accounting = scheduler_accounting_set(1);
+    ipc_queue_t *queues[STRESS_MAX_WORKERS];
+    uint32_t nqueues = 0;
+    int short_of_slots = 0;
+
+    for (uint32_t i = 0; i < cfg->cpu; i++)
+        short_of_slots |= start_worker(KIND_CPU, cpu_worker, 0);
+    for (uint32_t i = 0; i < cfg->pairs && nqueues < STRESS_MAX_WORKERS; i++)
+    {
+        ipc_queue_t *q = (ipc_queue_t *)heap_alloc(sizeof(ipc_queue_t));
+        if (!q)
+        {
+            short_of_slots = -1;
+            break;
+        }
+        ipc_init(q);
+        queues[nqueues++] = q;
+        /* Consumer first so a producer never outlives its only reader */
+        if (start_worker(KIND_CONSUMER, consumer_worker, q) < 0)
+        {
+            short_of_slots = -1;
+            break;
+        }
+        if (start_worker(KIND_PRODUCER, producer_worker, q) < 0)
+        {
+            /* Without a producer the consumer needs its stop token now */
+            ipc_send(q, PAIR_STOP);
+            short_of_slots = -1;
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < cfg->churn; i++)
+        short_of_slots |= start_worker(KIND_CHURN, churn_worker, 0);
+    for (uint32_t i = 0; i < cfg->spawners; i++)
+        short_of_slots |= start_worker(KIND_SPAWN, spawn_worker, 0);
+
+    if (short_of_slots)
+    {
+        serial_puts("stress: process table or heap full, running fewer workers\n");
+    }
+
+    uint64_t start = rdtsc();
+    uint64_t deadline = start + tsc_ms_to_cycles(cfg->duration_ms);
+    while (rdtsc() < deadline)
+    {
+        scheduler_yield();
+    }
+    uint32_t elapsed_ms = tsc_cycles_to_ms(rdtsc() - start);
+
+    stop_flag = 1;
+    while (live > 0)
+    {
+        scheduler_yield();
+    }
+
+    for (uint32_t i = 0; i < nqueues; i++)
+    {
+        heap_free(queues[i]);
+    }
+    scheduler_accounting_set(was_accounting);
+    report(elapsed_ms);
+    active_cfg = 0;
+    return 0;
+}
@@ -0,0 +1,28 @@
+/* stress.h - Synthetic load generators launched from the shell */
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "types.h"
+
+#define STRESS_MAX_WORKERS 12
+
+#define STRESS_DIST_UNIFORM 0 /* sizes spread evenly over [min, max] */
+#define STRESS_DIST_SMALL 1   /* skewed towards min, like object caches */
+#define STRESS_DIST_BIMODAL 2 /* mostly min-sized with occasional max */
+
+typedef struct stress_config
+{
+    uint32_t cpu;      /* CPU-bound spinners */
+    uint32_t pairs;    /* producer/consumer pairs over IPC */
+    uint32_t churn;    /* allocation churn workers */
+    uint32_t spawners; /* spawn/exit storm workers */
+    uint32_t duration_ms;
+    uint32_t size_min;
+    uint32_t size_max;
+    uint32_t dist;
+} stress_config_t;
+
+void stress_default_config(stress_config_t *cfg);
+int stress_run(const stress_config_t *cfg);
+
+#endif
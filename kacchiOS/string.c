@@ -1,18 +1,228 @@
 /* string.c - String utility implementations */
 #include "string.h"
+#include "cpu.h"
+
+/* Below this size the setup cost of the SSE2 path outweighs its gain */
+#define SSE2_MIN_BYTES 256
+/* Above this size, stream stores so a copy does not evict the whole cache */
+#define SSE2_NT_MIN_BYTES (256 * 1024)
+
+#define WORD_ONES 0x01010101u
+#define WORD_HIGHS 0x80808080u
+#define HAS_ZERO_BYTE(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+/* Word loads over char data must not be assumed not to alias */
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+extern void memcpy_sse2_blocks(void *dst, const void *src, size_t blocks);
+extern void memcpy_sse2_nt_blocks(void *dst, const void *src, size_t blocks);
+extern void memset_sse2_blocks(void *dst, uint32_t pattern, size_t blocks);
+
+static int use_sse2 = 0;
+
+void string_init(void)
+{
+    uint32_t a, b, c, d;
+    uint32_t need = CPUID_EDX_FXSR | CPUID_EDX_SSE | CPUID_EDX_SSE2;
+
+    cpuid(0, &a, &b, &c, &d);
+    if (a < 1 || (cpuid_edx(1) & need) != need)
+    {
+        use_sse2 = 0;
+        return;
+    }
+
+    /* Enable SSE: no x87 emulation, monitor coprocessor, OS FXSAVE support */
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP);
+    write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    use_sse2 = 1;
+}
+
+int string_sse2_enabled(void)
+{
+    return use_sse2;
+}
+
+/* rep-prefixed string instructions; these advance the pointers in place */
+
+static inline void rep_movsb(uint8_t **d, const uint8_t **s, size_t n)
+{
+    __asm__ volatile("rep movsb" : "+D"(*d), "+S"(*s), "+c"(n) : : "memory");
+}
+
+static inline void rep_movsd(uint8_t **d, const uint8_t **s, size_t n)
+{
+    __asm__ volatile("rep movsl" : "+D"(*d), "+S"(*s), "+c"(n) : : "memory");
+}
+
+static inline void rep_stosb(uint8_t **d, uint32_t v, size_t n)
+{
+    __asm__ volatile("rep stosb" : "+D"(*d), "+c"(n) : "a"(v) : "memory");
+}
+
+static inline void rep_stosd(uint8_t **d, uint32_t v, size_t n)
+{
+    __asm__ volatile("rep stosl" : "+D"(*d), "+c"(n) : "a"(v) : "memory");
+}
+
+void *memcpy(void *dest, const void *src, size_t n)
+{
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+
+    if (use_sse2 && n >= SSE2_MIN_BYTES)
+    {
+        size_t head = (16 - ((uint32_t)d & 15)) & 15;
+        rep_movsb(&d, &s, head);
+        n -= head;
+
+        size_t blocks = n / 64;
+        if (n >= SSE2_NT_MIN_BYTES)
+            memcpy_sse2_nt_blocks(d, s, blocks);
+        else
+            memcpy_sse2_blocks(d, s, blocks);
+        d += blocks * 64;
+        s += blocks * 64;
+        n &= 63;
+    }
+    else if (n >= 16)
+    {
+        size_t head = (4 - ((uint32_t)d & 3)) & 3;
+        rep_movsb(&d, &s, head);
+        n -= head;
+    }
+
+    rep_movsd(&d, &s, n / 4);
+    rep_movsb(&d, &s, n & 3);
+    return dest;
+}
+
+void *memmove(void *dest, const void *src, size_t n)
+{
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+
+    if (d <= s || d >= s + n)
+    {
+        return memcpy(dest, src, n);
+    }
+
+    /* Overlapping with dest above src: copy top-down, whole words first
+       and then the leftover bytes at the bottom */
+    size_t words = n / 4;
+    size_t rem = n & 3;
+    uint8_t *dw = d + n - 4;
+    const uint8_t *sw = s + n - 4;
+    uint8_t *db = d + rem - 1;
+    const uint8_t *sb = s + rem - 1;
+
+    __asm__ volatile("std\n\trep movsl\n\tcld"
+                     : "+D"(dw), "+S"(sw), "+c"(words)
+                     :
+                     : "memory");
+    __asm__ volatile("std\n\trep movsb\n\tcld"
+                     : "+D"(db), "+S"(sb), "+c"(rem)
+                     :
+                     : "memory");
+    return dest;
+}
+
+void *memset(void *dest, int c, size_t n)
+{
+    uint8_t *d = (uint8_t *)dest;
+    uint32_t pattern = (uint8_t)c * WORD_ONES;
+
+    if (use_sse2 && n >= SSE2_MIN_BYTES)
+    {
+        size_t head = (16 - ((uint32_t)d & 15)) & 15;
+        rep_stosb(&d, pattern, head);
+        n -= head;
+
+        size_t blocks = n / 64;
+        memset_sse2_blocks(d, pattern, blocks);
+        d += blocks * 64;
+        n &= 63;
+    }
+    else if (n >= 16)
+    {
+        size_t head = (4 - ((uint32_t)d & 3)) & 3;
+        rep_stosb(&d, pattern, head);
+        n -= head;
+    }
+
+    rep_stosd(&d, pattern, n / 4);
+    rep_stosb(&d, pattern, n & 3);
+    return dest;
+}
+
+int memcmp(const void *s1, const void *s2, size_t n)
+{
+    const uint8_t *a = (const uint8_t *)s1;
+    const uint8_t *b = (const uint8_t *)s2;
+
+    while (n >= 4 && *(const word_t *)a == *(const word_t *)b)
+    {
+        a += 4;
+        b += 4;
+        n -= 4;
+    }
+    while (n--)
+    {
+        if (*a != *b)
+            return *a - *b;
+        a++;
+        b++;
+    }
+    return 0;
+}
 
 size_t strlen(const char *str)
 {
-    size_t len = 0;
-    while (str[len])
+    const char *p = str;
+
+    /* Aligned word loads never cross into an unmapped page */
+    while ((uint32_t)p & 3)
+    {
+        if (!*p)
+            return p - str;
+        p++;
+    }
+    const word_t *w = (const word_t *)p;
+    while (!HAS_ZERO_BYTE(*w))
+    {
+        w++;
+    }
+    p = (const char *)w;
+    while (*p)
     {
-        len++;
+        p++;
     }
-    return len;
+    return p - str;
 }
 
 int strcmp(const char *str1, const char *str2)
 {
+    /* Word-at-a-time only works when both strings share an alignment */
+    if ((((uint32_t)str1 ^ (uint32_t)str2) & 3) == 0)
+    {
+        while ((uint32_t)str1 & 3)
+        {
+            if (!*str1 || *str1 != *str2)
+                return *(unsigned char *)str1 - *(unsigned char *)str2;
+            str1++;
+            str2++;
+        }
+        const word_t *w1 = (const word_t *)str1;
+        const word_t *w2 = (const word_t *)str2;
+        while (*w1 == *w2 && !HAS_ZERO_BYTE(*w1))
+        {
+            w1++;
+            w2++;
+        }
+        str1 = (const char *)w1;
+        str2 = (const char *)w2;
+    }
+
     while (*str1 && (*str1 == *str2))
     {
         str1++;
@@ -58,4 +268,4 @@ char *strcpy(char *dest, const char *src)
     while ((*dest++ = *src++))
         ;
     return original_dest;
-}
\ No newline at end of file
+}
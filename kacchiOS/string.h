@@ -1,13 +1,21 @@
-/* string.h - String utility functions */
+/* string.h - String and memory utility functions */
 #ifndef STRING_H
 #define STRING_H
 
 #include "types.h"
 
+void string_init(void);
+int string_sse2_enabled(void);
+
+void *memcpy(void *dest, const void *src, size_t n);
+void *memmove(void *dest, const void *src, size_t n);
+void *memset(void *dest, int c, size_t n);
+int memcmp(const void *s1, const void *s2, size_t n);
+
 size_t strlen(const char *str);
 int strcmp(const char *str1, const char *str2);
 char *strcpy(char *dest, const char *src);
 int strncmp(const char *s1, const char *s2, size_t n);
 int atoi(const char *s);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,103 @@
+/* syscall.c - System calls from ring 3 over the existing kernel APIs */
+#include "syscall.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "paging.h"
+#include "process.h"
+#include "scheduler.h"
+#include "serial.h"
+
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+extern void sysenter_entry(void);
+
+static ipc_queue_t *queues[SYSCALL_MAX_QUEUES];
+static int sysenter_ok = 0;
+
+int syscall_init(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(0, &a, &b, &c, &d);
+    if (a < 1 || !(cpuid_edx(1) & CPUID_EDX_SEP) || !(cpuid_edx(1) & CPUID_EDX_MSR))
+    {
+        sysenter_ok = 0;
+        return 0;
+    }
+
+    wrmsr(MSR_SYSENTER_CS, GDT_KERNEL_CODE);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)gdt_kernel_stack_slot());
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+    sysenter_ok = 1;
+    return 1;
+}
+
+int syscall_available(void)
+{
+    return sysenter_ok;
+}
+
+int syscall_register_queue(int id, ipc_queue_t *q)
+{
+    if (id < 0 || id >= SYSCALL_MAX_QUEUES)
+    {
+        return -1;
+    }
+    queues[id] = q;
+    return 0;
+}
+
+static ipc_queue_t *lookup_queue(uint32_t id)
+{
+    return id < SYSCALL_MAX_QUEUES ? queues[id] : 0;
+}
+
+uint32_t syscall_dispatch(uint32_t num, uint32_t a, uint32_t b, uint32_t c)
+{
+    (void)c;
+    percpu_inc(syscalls);
+    percpu_trace(TRACE_SYSCALL, num);
+    switch (num)
+    {
+    case SYS_EXIT:
+        process_exit();
+        return 0;
+    case SYS_YIELD:
+        scheduler_yield();
+        return 0;
+    case SYS_GETPID:
+        return (uint32_t)process_current()->pid;
+    case SYS_WRITE:
+    {
+        const char *buf = (const char *)a;
+        if (!buf || !vm_user_ok(a, b, 0))
+            return (uint32_t)-1;
+        for (uint32_t i = 0; i < b; i++)
+        {
+            serial_putc(buf[i]);
+        }
+        return b;
+    }
+    case SYS_PUTU:
+        serial_putu(a);
+        return 0;
+    case SYS_GETC:
+        return serial_available() ? (uint32_t)(uint8_t)serial_getc() : (uint32_t)-1;
+    case SYS_ALLOC:
+        return (uint32_t)process_alloc(a);
+    case SYS_FREE:
+        process_free((void *)a);
+        return 0;
+    case SYS_SEND:
+        return (uint32_t)ipc_send(lookup_queue(a), b);
+    case SYS_RECV:
+        if (!vm_user_ok(b, sizeof(uint32_t), 1))
+            return (uint32_t)-1;
+        return (uint32_t)ipc_recv(lookup_queue(a), (uint32_t *)b);
+    case SYS_NULL:
+        return 0;
+    default:
+        return (uint32_t)-1;
+    }
+}
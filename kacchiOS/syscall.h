@@ -0,0 +1,41 @@
+/* syscall.h - SYSENTER system call interface
+ *
+ * Calling convention (see programs/usys.h for the user-side stubs):
+ *   eax = call number, ebx/esi/edi = arguments, eax = return value,
+ *   ecx = user esp and edx = user return address for SYSEXIT.
+ */
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#include "types.h"
+
+#define SYS_EXIT 0
+#define SYS_YIELD 1
+#define SYS_GETPID 2
+#define SYS_WRITE 3 /* (buf, len) */
+#define SYS_PUTU 4  /* (value) */
+#define SYS_GETC 5  /* non-blocking, -1 if no input */
+#define SYS_ALLOC 6 /* (size) from the caller's arena, gone at exit */
+#define SYS_FREE 7  /* (ptr) reclaims only the newest or a large block */
+#define SYS_SEND 8  /* (queue, value) */
+#define SYS_RECV 9  /* (queue, uint32_t *out) */
+#define SYS_NULL 10 /* does nothing; for measuring entry/exit cost */
+#define SYS_COUNT 11
+
+#define SYSCALL_MAX_QUEUES 4
+
+#ifndef SYSCALL_USER
+
+#include "ipc.h"
+
+int syscall_init(void);
+int syscall_available(void);
+int syscall_register_queue(int id, ipc_queue_t *q);
+uint32_t syscall_dispatch(uint32_t num, uint32_t a, uint32_t b, uint32_t c);
+
+/* Leave the kernel for ring 3 at eip with the given user stack */
+void user_mode_enter(uint32_t eip, uint32_t esp) __attribute__((noreturn));
+
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+/* timer.c - Periodic PIT interrupt
+ *
+ * The top half only counts the tick and queues the bottom half; a burst
+ * of ticks while processes are busy is handled by one run that sees the
+ * whole count. The bottom half keeps serial and console output moving even
+ * when no process is polling the UART.
+ */
+#include "timer.h"
+#include "defer.h"
+#include "io.h"
+#include "irq.h"
+#include "serial.h"
+
+#define PIT_HZ 1193182
+#define PIT_CH0_DATA 0x40
+#define PIT_COMMAND 0x43
+
+static volatile uint32_t ticks = 0;
+static work_t tick_work;
+
+static void tick_bottom_half(work_t *work, uint32_t count)
+{
+    (void)work;
+    (void)count;
+    serial_poll();
+}
+
+static void timer_irq(void)
+{
+    ticks++;
+    work_queue(&tick_work);
+}
+
+int timer_init(void)
+{
+    uint32_t divisor = PIT_HZ / TIMER_HZ;
+    work_init(&tick_work, tick_bottom_half, 0);
+
+    outb(PIT_COMMAND, 0x34); /* channel 0, lo/hi byte, mode 2 rate generator */
+    outb(PIT_CH0_DATA, divisor & 0xFF);
+    outb(PIT_CH0_DATA, (divisor >> 8) & 0xFF);
+    return irq_register(IRQ_TIMER, timer_irq);
+}
+
+uint32_t timer_ticks(void)
+{
+    return ticks;
+}
@@ -0,0 +1,12 @@
+/* timer.h - PIT channel 0 periodic tick */
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+
+#define TIMER_HZ 100
+
+int timer_init(void);
+uint32_t timer_ticks(void);
+
+#endif
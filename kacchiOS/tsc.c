@@ -0,0 +1,72 @@
+/* tsc.c - Measure the TSC rate with a one-shot PIT channel 2 countdown */
+#include "tsc.h"
+#include "cpu.h"
+#include "io.h"
+
+#define PIT_HZ 1193182
+#define PIT_CH2_DATA 0x42
+#define PIT_COMMAND 0x43
+#define PIT_GATE_PORT 0x61 /* bit 0: channel 2 gate, bit 1: speaker, bit 5: OUT2 */
+#define CALIBRATE_MS 10
+
+static uint32_t cycles_per_ms = 1000000; /* assume 1 GHz if calibration fails */
+static int calibrated = 0;
+
+/* The 10 ms measurement is deferred until a conversion first needs it */
+static uint32_t rate(void)
+{
+    if (!calibrated)
+    {
+        tsc_calibrate();
+    }
+    return cycles_per_ms;
+}
+
+void tsc_calibrate(void)
+{
+    uint32_t count = PIT_HZ / (1000 / CALIBRATE_MS);
+
+    /* Gate channel 2 on with the speaker disconnected */
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01);
+    outb(PIT_COMMAND, 0xB0); /* channel 2, lo/hi byte, mode 0 */
+    outb(PIT_CH2_DATA, count & 0xFF);
+    outb(PIT_CH2_DATA, (count >> 8) & 0xFF);
+
+    uint64_t start = rdtsc();
+    while (!(inb(PIT_GATE_PORT) & 0x20))
+        ;
+    uint64_t elapsed = rdtsc() - start;
+
+    uint32_t measured = (uint32_t)udiv64_32(elapsed, CALIBRATE_MS);
+    if (measured)
+    {
+        cycles_per_ms = measured;
+    }
+    calibrated = 1;
+}
+
+uint32_t tsc_cycles_per_ms(void)
+{
+    return rate();
+}
+
+uint64_t tsc_ms_to_cycles(uint32_t ms)
+{
+    return (uint64_t)ms * rate();
+}
+
+uint64_t tsc_us_to_cycles(uint32_t us)
+{
+    return udiv64_32((uint64_t)us * rate(), 1000);
+}
+
+uint32_t tsc_cycles_to_ms(uint64_t cycles)
+{
+    return (uint32_t)udiv64_32(cycles, rate());
+}
+
+uint32_t tsc_cycles_to_us(uint64_t cycles)
+{
+    uint32_t per_us = rate() / 1000;
+    return (uint32_t)udiv64_32(cycles, per_us ? per_us : 1);
+}
@@ -0,0 +1,14 @@
+/* tsc.h - Time stamp counter calibrated against the PIT */
+#ifndef TSC_H
+#define TSC_H
+
+#include "types.h"
+
+void tsc_calibrate(void);
+uint32_t tsc_cycles_per_ms(void);
+uint64_t tsc_ms_to_cycles(uint32_t ms);
+uint64_t tsc_us_to_cycles(uint32_t us);
+uint32_t tsc_cycles_to_ms(uint64_t cycles);
+uint32_t tsc_cycles_to_us(uint64_t cycles);
+
+#endif
@@ -2,6 +2,14 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#ifdef KACCHI_HOST
+/* Hosted build (make host): take the fixed-width types from the C library */
+#include <stddef.h>
+#include <stdint.h>
+#else
+
+typedef unsigned long long uint64_t;
+typedef long long          int64_t;
 typedef unsigned int   uint32_t;
 typedef unsigned short uint16_t;
 typedef unsigned char  uint8_t;
@@ -10,7 +18,10 @@ typedef short          int16_t;
 typedef char           int8_t;
 
 typedef uint32_t size_t;
+typedef uint32_t uintptr_t;
 
 #define NULL  ((void*)0)
 
+#endif /* KACCHI_HOST */
+
 #endif
\ No newline at end of file
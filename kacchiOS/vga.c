@@ -0,0 +1,154 @@
+/* vga.c - Double-buffered VGA text console
+ *
+ * Output goes to a shadow copy of the 80x25 text screen in ordinary RAM;
+ * each written row sets a bit in a dirty mask. Scrolling is one memmove
+ * of the shadow buffer. vga_flush() copies runs of dirty rows to video
+ * memory with one memcpy per run, so a burst of output that scrolls the
+ * screen many times costs at most one screenful of slow MMIO writes.
+ */
+#include "vga.h"
+#include "io.h"
+#include "string.h"
+
+#define VGA_MEMORY ((uint16_t *)0xB8000)
+#define VGA_ATTR 0x0700 /* light grey on black */
+#define VGA_BLANK (VGA_ATTR | ' ')
+#define VGA_ALL_ROWS ((1u << VGA_ROWS) - 1)
+#define VGA_TAB 8
+
+#define CRTC_INDEX 0x3D4
+#define CRTC_DATA 0x3D5
+
+static uint16_t shadow[VGA_ROWS * VGA_COLS];
+static uint32_t dirty = 0; /* bit n set: row n differs from video memory */
+static uint32_t row = 0;
+static uint32_t col = 0;
+static uint32_t cursor_moved = 0;
+static vga_stats_t stats;
+
+static void clear_row(uint32_t r)
+{
+    uint16_t *p = &shadow[r * VGA_COLS];
+    for (int i = 0; i < VGA_COLS; i++)
+    {
+        p[i] = VGA_BLANK;
+    }
+}
+
+void vga_init(void)
+{
+    for (uint32_t r = 0; r < VGA_ROWS; r++)
+    {
+        clear_row(r);
+    }
+    row = col = 0;
+    dirty = VGA_ALL_ROWS;
+    cursor_moved = 1;
+    memset(&stats, 0, sizeof(stats));
+    vga_flush();
+}
+
+static void scroll(void)
+{
+    memmove(shadow, &shadow[VGA_COLS], (VGA_ROWS - 1) * VGA_COLS * sizeof(uint16_t));
+    clear_row(VGA_ROWS - 1);
+    dirty = VGA_ALL_ROWS;
+    stats.scrolls++;
+}
+
+static void newline(void)
+{
+    col = 0;
+    if (++row == VGA_ROWS)
+    {
+        scroll();
+        row = VGA_ROWS - 1;
+    }
+}
+
+void vga_putc(char c)
+{
+    stats.chars++;
+    cursor_moved = 1;
+    switch (c)
+    {
+    case '\n':
+        newline();
+        return;
+    case '\r':
+        col = 0;
+        return;
+    case '\b':
+        if (col)
+        {
+            col--;
+            shadow[row * VGA_COLS + col] = VGA_BLANK;
+            dirty |= 1u << row;
+        }
+        return;
+    case '\t':
+        col = (col + VGA_TAB) & ~(uint32_t)(VGA_TAB - 1);
+        if (col >= VGA_COLS)
+        {
+            newline();
+        }
+        return;
+    default:
+        break;
+    }
+
+    shadow[row * VGA_COLS + col] = (uint16_t)(VGA_ATTR | (uint8_t)c);
+    dirty |= 1u << row;
+    if (++col == VGA_COLS)
+    {
+        newline();
+    }
+}
+
+static void move_cursor(void)
+{
+    uint16_t pos = (uint16_t)(row * VGA_COLS + col);
+    outb(CRTC_INDEX, 0x0F);
+    outb(CRTC_DATA, (uint8_t)(pos & 0xFF));
+    outb(CRTC_INDEX, 0x0E);
+    outb(CRTC_DATA, (uint8_t)(pos >> 8));
+}
+
+void vga_flush(void)
+{
+    if (cursor_moved)
+    {
+        move_cursor();
+        cursor_moved = 0;
+    }
+    if (!dirty)
+    {
+        return;
+    }
+
+    uint32_t mask = dirty;
+    dirty = 0;
+    stats.flushes++;
+    uint32_t r = 0;
+    while (mask >> r)
+    {
+        if (!(mask & (1u << r)))
+        {
+            r++;
+            continue;
+        }
+        uint32_t first = r;
+        while (r < VGA_ROWS && (mask & (1u << r)))
+        {
+            r++;
+        }
+        memcpy(&VGA_MEMORY[first * VGA_COLS], &shadow[first * VGA_COLS],
+               (r - first) * VGA_COLS * sizeof(uint16_t));
+        stats.rows_copied += r - first;
+    }
+}
+
+void vga_get_stats(vga_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,25 @@
+/* vga.h - Double-buffered VGA text console (80x25 at 0xB8000) */
+#ifndef VGA_H
+#define VGA_H
+
+#include "types.h"
+
+#define VGA_COLS 80
+#define VGA_ROWS 25
+
+typedef struct vga_stats
+{
+    uint32_t chars;       /* characters written to the shadow buffer */
+    uint32_t scrolls;     /* lines scrolled in the shadow buffer */
+    uint32_t flushes;     /* flushes that copied at least one row */
+    uint32_t rows_copied; /* rows copied to video memory */
+} vga_stats_t;
+
+void vga_init(void);
+/* Writes only touch the shadow buffer and mark rows dirty */
+void vga_putc(char c);
+/* Copy dirty rows to video memory and move the hardware cursor */
+void vga_flush(void);
+void vga_get_stats(vga_stats_t *out);
+
+#endif